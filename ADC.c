@@ -13,27 +13,74 @@
 
 #include "Timer.h"
 #include "ADC.h"
-
-uint16_t ADC_DataExternalInput;
-uint16_t ADC_DataDCInput;
-uint16_t ADC_DataBattery1;
-uint16_t ADC_DataBattery2;
-uint16_t ADC_DataBattery3;
+#include "Diag.h"
+#include "Snapshot.h"
+#include "Event.h"
+#include "Switch.h"
+
+volatile ADC_Pair ADC_DataExternalInput;
+volatile ADC_Pair ADC_DataDCInput;
+volatile ADC_Pair ADC_DataBattery1;
+volatile ADC_Pair ADC_DataBattery2;
+volatile ADC_Pair ADC_DataBattery3;
+volatile uint16_t ADC_DataBattSense;
+uint8_t ADC_WindowBelow;				// last EVENT_ADC_WINDOW posted was below
+SnapshotSeq ADC_BattSenseCount;			// published by the ADC1 ISR, new pack reading
+SnapshotSeq ADC_PairCount;				// published each time both halves of a pair are in
+volatile uint8_t ADC_ScanCount;			// bumped each time the last scanned input is in
+
+//halves of the pair in since the last one was taken, each converter has its own RESRDY
+//interrupt and whichever finishes second takes the pair
+#define ADC_PAIR_ADC0	0x01
+#define ADC_PAIR_ADC1	0x02
+#define ADC_PAIR_BOTH	(ADC_PAIR_ADC0 | ADC_PAIR_ADC1)
+uint8_t ADC_PairIn;						// only touched by the two ISRs and with both ADCs off
 
 void (*ADC0FunctionPntr)(void);
-void (*ADC1FunctionPntr)(void);
+
+//ADC0 scan, one input per trigger.  With the button ladder fitted EXT_IN is not in the scan,
+//it gets a single sample conversion of its own straight after every pair
+const uint8_t ADC_ScanMux[] =
+{
+#if !SWITCH_LADDER_FITTED
+	ADC_CHAN_EXT_IN,
+#endif
+	ADC_CHAN_DC_IN,
+	ADC_CHAN_BAT1,
+#if ADC_CELL_TAPS_FITTED
+	ADC_CHAN_BAT2,
+	ADC_CHAN_BAT3,
+#endif
+};
+
+volatile ADC_Pair * const ADC_ScanData[] =
+{
+#if !SWITCH_LADDER_FITTED
+	&ADC_DataExternalInput,
+#endif
+	&ADC_DataDCInput,
+	&ADC_DataBattery1,
+#if ADC_CELL_TAPS_FITTED
+	&ADC_DataBattery2,
+	&ADC_DataBattery3,
+#endif
+};
+
+#define ADC_SCAN_COUNT	(sizeof(ADC_ScanMux) / sizeof(ADC_ScanMux[0]))
+
+uint8_t ADC_ScanIndex;					// scanned input converting, or next after EXT_IN
 
 //local Functions
 void ADC_ExternalInput(void);
-void ADC_DCInput(void);
-void ADC_Battery1(void);
-void ADC_Battery2(void);
-void ADC_Battery3(void);
+void ADC_ScanInput(void);
+static void ADC_PairHalf(uint8_t Half);
 
 
 //*--------------------------------------------------------------------------------------
 //* Function Name       : ADC_Init
 //* Object              : Analog Digital Converter Initialize
+//*                       ADC0 scans the analog inputs, ADC1 reads the pack, both are
+//*                       started together from one event channel off the TCB1 tick
 //* Input Parameters    : none
 //* Output Parameters   : none
 //*--------------------------------------------------------------------------------------
@@ -42,132 +89,304 @@ void ADC_Init(void)
 {
 	VREF.CTRLA = VREF_DAC0REFSEL_1V1_gc | VREF_ADC0REFSEL_1V1_gc;
 	VREF.CTRLC = VREF_ADC1REFSEL_1V1_gc;
+#if SWITCH_LADDER_FITTED
+	VREF.CTRLB = VREF_ADC0REFEN_bm;		// keep 1V1 up while ADC0 reads EXT_IN against VDD
+#endif
 	
 	
-	//configure pins
+	//configure pins, the pack sense on PA7 is set up by LowVoltKill_init()
 	ADC_CHAN_EXT_IN_PORT.OUTCLR = ADC_CHAN_EXT_IN_BIT;
 	ADC_CHAN_INPUT_PORT.OUTCLR = ADC_CHAN_INPUT_BIT;
 	ADC_CHAN_BAT1_PORT.OUTCLR = ADC_CHAN_BAT1_BIT;
-	ADC_CHAN_BAT2_PORT.OUTCLR = ADC_CHAN_BAT2_BIT;
-	ADC_CHAN_BAT3_PORT.OUTCLR = ADC_CHAN_BAT3_BIT;
 
-	//disable inputs
+	//disable inputs.  No pull-up on EXT_IN, the ladder windows are worked out for its own 10k
+	//alone and the internal 20-50k in parallel would move every button out of its window
 	ADC_CHAN_EXT_IN_CTRL = (4 << PORT_ISC0_bp);
 	ADC_CHAN_INPUT_CTRL = (4 << PORT_ISC0_bp);
 	ADC_CHAN_BAT1_CTRL = (4 << PORT_ISC0_bp);
+
+#if ADC_CELL_TAPS_FITTED
+	ADC_CHAN_BAT2_PORT.OUTCLR = ADC_CHAN_BAT2_BIT;
+	ADC_CHAN_BAT3_PORT.OUTCLR = ADC_CHAN_BAT3_BIT;
 	ADC_CHAN_BAT2_CTRL = (4 << PORT_ISC0_bp);
 	ADC_CHAN_BAT3_CTRL = (4 << PORT_ISC0_bp);
 
 	//enable ADC channels
 	ADC_ENA_CHANNELS_PORT.DIRSET = ADC_ENA_CHANNELS_BIT;
 	ADC_ENA_CHANNELS_PORT.OUTSET = ADC_ENA_CHANNELS_BIT;
+#endif
 
-	//Set up ADC 1
+	//Set up ADC 0
     ADC0.CTRLA = ADC_RESSEL_10BIT_gc; // 10-bit resolution
     ADC0.CTRLB = ADC_SAMPNUM_ACC16_gc; // 16 samples per read
     ADC0.CTRLC = ADC_REFSEL_INTREF_gc | ADC_SAMPCAP_bm; // Internal reference, low capacitance
-	ADC0.CTRLC |= ADC_PRESC_DIV32_gc; // Peripheral clock / 32
+	ADC0.CTRLC |= ADC_PRESC_DIV16_gc; // Peripheral clock / 16, about 0.5mS per read at 8MHz
+	ADC0.EVCTRL = ADC_STARTEI_bm; // start on the trigger event
+	ADC0.INTCTRL = ADC_RESRDY_bm;
 	ADC0.CTRLA |= ADC_ENABLE_bm;
 
-	////Set up ADC 1
-    //ADC1.CTRLA = ADC_RESSEL_10BIT_gc; // 10-bit resolution
-    //ADC1.CTRLB = ADC_SAMPNUM_ACC16_gc; // 16 samples per read
-    //ADC1.CTRLC = ADC_REFSEL_INTREF_gc | ADC_SAMPCAP_bm; // Internal reference, low capacitance
-	//ADC1.CTRLC |= ADC_PRESC_DIV32_gc; // Peripheral clock / 32
-	//ADC1.CTRLA |= ADC_ENABLE_bm;
-	//
-	ADC0.MUXPOS = (ADC_CHAN_EXT_IN << ADC_MUXPOS_gp);
-	ADC0.COMMAND = ADC_STCONV_bm;
-//
-	//ADC1.MUXPOS = (ADC_CHAN_BAT2 << ADC_MUXPOS_gp);
-	//ADC1.COMMAND = ADC_STCONV_bm;
+	//Set up ADC 1, same timing as ADC 0 so the two finish together
+    ADC1.CTRLA = ADC_RESSEL_10BIT_gc; // 10-bit resolution
+    ADC1.CTRLB = ADC_SAMPNUM_ACC16_gc; // 16 samples per read
+    ADC1.CTRLC = ADC_REFSEL_INTREF_gc | ADC_SAMPCAP_bm; // Internal reference, low capacitance
+	ADC1.CTRLC |= ADC_PRESC_DIV16_gc; // Peripheral clock / 16
+	ADC1.EVCTRL = ADC_STARTEI_bm; // start on the trigger event
+	ADC1.INTCTRL = ADC_RESRDY_bm;
+	ADC1.CTRLA |= ADC_ENABLE_bm;
+
+	ADC_ScanIndex = 0;
+	ADC0.MUXPOS = (ADC_ScanMux[0] << ADC_MUXPOS_gp);
+	ADC1.MUXPOS = (ADC1_CHAN_BATT_SENSE << ADC_MUXPOS_gp);
+
+	ADC0FunctionPntr = ADC_ScanInput;
+	ADC_BattSenseCount = 0;
+	ADC_PairCount = 0;
+	ADC_PairIn = 0;
+
+	//One trigger for both converters, TCB1 is started by Timer_tickInit()
+	EVSYS.SYNCCH0 = ADC_TRIGGER_GEN;
+	EVSYS.ASYNCUSER1 = EVSYS_ASYNCUSER1_SYNCCH0_gc;		// ADC0
+	EVSYS.ASYNCUSER12 = EVSYS_ASYNCUSER12_SYNCCH0_gc;	// ADC1
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ADC_Power
+//* Object              : stop or restart both converters, off while charging where a 16
+//*                       sample read at 32kHz / 16 takes longer than a tick.  A half pair
+//*                       left from before the stop is dropped
+//* Input Parameters    : uint8_t On = 1 on, 0 off
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
 
-	ADC0FunctionPntr = ADC_DCInput;
-	//ADC1FunctionPntr = ADC_ExternalInput;
+void ADC_Power(uint8_t On)
+{
+	if(On)
+	{
+		ADC_PairIn = 0;
+		ADC1.CTRLA |= ADC_ENABLE_bm;
+		ADC0.CTRLA |= ADC_ENABLE_bm;
+	}
+	else
+	{
+		ADC0.CTRLA &= ~ADC_ENABLE_bm;
+		ADC1.CTRLA &= ~ADC_ENABLE_bm;
+		ADC0.INTFLAGS = ADC_RESRDY_bm;
+		ADC1.INTFLAGS = ADC_RESRDY_bm;
+	}
 }
 
 
 //*--------------------------------------------------------------------------------------
-//* Function Name       : ADC_Update
-//* Object              : Analog Digital Converter Update
+//* Function Name       : ADC0_RESRDY_vect
+//* Object              : ADC0 half of the pair is in.  RES is left for ADC0FunctionPntr()
+//*                       when the pair is taken, so the flag is cleared by hand
 //* Input Parameters    : none
 //* Output Parameters   : none
 //*--------------------------------------------------------------------------------------
 
-void ADC_Update(void)
+ISR(ADC0_RESRDY_vect)
 {
-	if (ADC0.INTFLAGS & ADC_RESRDY_bm)
+	DIAG_ISR_ENTER();
+
+#if SWITCH_LADDER_FITTED
+	// EXT_IN was started by hand after the pair, it has no ADC1 half
+	if(ADC0FunctionPntr == ADC_ExternalInput)
 	{
-		ADC0FunctionPntr();
-		ADC0.COMMAND = ADC_STCONV_bm;
+		ADC_ExternalInput();
+		SNAPSHOT_PUBLISH(ADC_PairCount);
+		return;
 	}
+#endif
+
+	ADC0.INTFLAGS = ADC_RESRDY_bm;
 
-	//if (ADC1.INTFLAGS & ADC_RESRDY_bm)
-	//{
-		//ADC1FunctionPntr();
-		//ADC1.COMMAND = ADC_STCONV_bm;
-	//}
+	ADC_PairHalf(ADC_PAIR_ADC0);
 }
 
-void ADC_ExternalInput(void)
-{
-	ADC0.MUXPOS = (ADC_CHAN_EXT_IN << ADC_MUXPOS_gp);
-	ADC_DataBattery3 = ADC0.RES;
 
-	ADC0FunctionPntr = ADC_DCInput;
-}
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ADC1_RESRDY_vect
+//* Object              : new pack reading, publish it and check the window straight away,
+//*                       then hand in the ADC1 half of the pair
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
 
-void ADC_DCInput(void)
+ISR(ADC1_RESRDY_vect)
 {
-	ADC0.MUXPOS = (ADC_CHAN_DC_IN << ADC_MUXPOS_gp);
-	ADC_DataExternalInput = ADC0.RES;
+	DIAG_ISR_ENTER();
 
-	ADC0FunctionPntr = ADC_Battery1;
-}
+	ADC_DataBattSense = ADC_DECIMATE(ADC1.RES);
+	SNAPSHOT_PUBLISH(ADC_BattSenseCount);
 
-void ADC_Battery1(void)
-{
-	ADC0.MUXPOS = (ADC_CHAN_BAT1 << ADC_MUXPOS_gp);
-	ADC_DataDCInput = ADC0.RES;
+	if(!ADC_WindowBelow && ADC_DataBattSense < ADC_WINDOW_LOW_CNT)
+	{
+		ADC_WindowBelow = 1;
+		Event_Post(EVENT_ADC_WINDOW, 1);
+	}
+	else if(ADC_WindowBelow && ADC_DataBattSense > ADC_WINDOW_LOW_CNT + ADC_WINDOW_HYST)
+	{
+		ADC_WindowBelow = 0;
+		Event_Post(EVENT_ADC_WINDOW, 0);
+	}
 
-	ADC0FunctionPntr = ADC_Battery2;
+	ADC_PairHalf(ADC_PAIR_ADC1);
 }
 
-void ADC_Battery2(void)
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ADC_PairHalf
+//* Object              : both converters start on the same trigger but finish a few cycles
+//*                       apart in either order.  Once both halves are in, store the ADC0
+//*                       result with the pack reading and move ADC0 on to its next input.
+//*                       A converter that misses a trigger only delays the pair, nothing waits
+//* Input Parameters    : uint8_t Half = ADC_PAIR_ADC0 or ADC_PAIR_ADC1
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void ADC_PairHalf(uint8_t Half)
 {
-	ADC0.MUXPOS = (ADC_CHAN_BAT2 << ADC_MUXPOS_gp);
-	ADC_DataBattery1 = ADC0.RES;
+	ADC_PairIn |= Half;
+
+	if(ADC_PairIn != ADC_PAIR_BOTH)
+	{
+		return;
+	}
+
+	ADC_PairIn = 0;
+
+	ADC0FunctionPntr();
 
-	ADC0FunctionPntr = ADC_Battery3;
+	SNAPSHOT_PUBLISH(ADC_PairCount);
 }
 
-void ADC_Battery3(void)
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ADC_ScanInput
+//* Object              : ADC0 chain, one of the scanned inputs has converted.  Store it and
+//*                       set up the next scanned input for the next trigger.  With the ladder
+//*                       fitted start EXT_IN now as one 10 bit sample against VDD, about 30uS,
+//*                       so it is in well before the next trigger
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void ADC_ScanInput(void)
 {
-	ADC0.MUXPOS = (ADC_CHAN_BAT3 << ADC_MUXPOS_gp);
-	ADC_DataBattery2 = ADC0.RES;
+	volatile ADC_Pair *Data = ADC_ScanData[ADC_ScanIndex];
+
+	Data->Value = ADC_DECIMATE(ADC0.RES);
+	Data->Pack = ADC_DataBattSense;
+
+	if(++ADC_ScanIndex >= ADC_SCAN_COUNT)
+	{
+		ADC_ScanIndex = 0;
+		ADC_ScanCount++;
+	}
 
+#if SWITCH_LADDER_FITTED
+	ADC0.MUXPOS = (ADC_CHAN_EXT_IN << ADC_MUXPOS_gp);
+	ADC0.CTRLB = ADC_SAMPNUM_ACC1_gc;
+	ADC0.CTRLC = ADC_REFSEL_VDDREF_gc | ADC_SAMPCAP_bm | ADC_PRESC_DIV16_gc;
+	ADC0.COMMAND = ADC_STCONV_bm;
 	ADC0FunctionPntr = ADC_ExternalInput;
+#else
+	ADC0.MUXPOS = (ADC_ScanMux[ADC_ScanIndex] << ADC_MUXPOS_gp);
+#endif
 }
 
 
 //*--------------------------------------------------------------------------------------
-//* Function Name       : ADC_ReadPin
-//* Object              : Read one of analog pins
+//* Function Name       : ADC_ExternalInput
+//* Object              : ADC0 chain, EXT_IN has converted.  Store it with the pack reading
+//*                       from this trigger, decode the button ladder, and set ADC0 back to
+//*                       the scanned inputs for the next trigger
 //* Input Parameters    : none
 //* Output Parameters   : none
 //*--------------------------------------------------------------------------------------
 
-int ADC_ReadPin(uint8_t ain)
+void ADC_ExternalInput(void)
 {
-    // 6. Configure an input by writing to the MUXPOS bit field in the MUXPOS (ADCn.MUXPOS) register.
-    ADC1.MUXPOS = (ain << ADC_MUXPOS_gp);
+	uint16_t Reading = ADC_SINGLE(ADC0.RES);
 
-    // Start conversion
-    ADC1.COMMAND = ADC_STCONV_bm;
+	ADC_DataExternalInput.Value = Reading;
+	ADC_DataExternalInput.Pack = ADC_DataBattSense;
 
-    // Wait for result ready
-    while (!(ADC1.INTFLAGS & ADC_RESRDY_bm)) {};
+	SwitchLadderSample(Reading);
 
-    // Result
-    return ADC1.RES;
+	ADC0.MUXPOS = (ADC_ScanMux[ADC_ScanIndex] << ADC_MUXPOS_gp);
+	ADC0.CTRLB = ADC_SAMPNUM_ACC16_gc;
+	ADC0.CTRLC = ADC_REFSEL_INTREF_gc | ADC_SAMPCAP_bm | ADC_PRESC_DIV16_gc;
+	ADC0FunctionPntr = ADC_ScanInput;
 }
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ADC_BattSenseUpdate
+//* Object              : check for a pack reading newer than the caller has seen, each
+//*                       user keeps its own count so several can watch the same reading
+//* Input Parameters    : uint8_t *LastCount = caller's count, updated when a new reading is in
+//*                       uint16_t *Battery = set to the reading when there is a new one
+//* Output Parameters   : uint8_t = 1 if ADC_DataBattSense has been updated since last call
+//*--------------------------------------------------------------------------------------
+
+uint8_t ADC_BattSenseUpdate(uint8_t *LastCount, uint16_t *Battery)
+{
+	uint8_t Count;
+	uint16_t Reading;
+
+	// the count and the reading from the same ISR pass
+	do
+	{
+		Count = ADC_BattSenseCount;
+		Reading = ADC_DataBattSense;
+	} while (Count != ADC_BattSenseCount);
+
+	if (Count != *LastCount)
+	{
+		*LastCount = Count;
+		*Battery = Reading;
+		return 1;
+	}
+	return 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ADC_ScanUpdate
+//* Object              : check for a whole new pass of the scanned inputs, each user keeps
+//*                       its own count like ADC_BattSenseUpdate()
+//* Input Parameters    : uint8_t *LastCount = caller's count, updated when a pass is in
+//* Output Parameters   : uint8_t = 1 if every scanned input has a reading newer than the last call
+//*--------------------------------------------------------------------------------------
+
+uint8_t ADC_ScanUpdate(uint8_t *LastCount)
+{
+	uint8_t Count = ADC_ScanCount;
+
+	if (Count == *LastCount)
+	{
+		return 0;
+	}
+
+	*LastCount = Count;
+	return 1;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ADC_ReadPair
+//* Object              : consistent copy of one of the ADC_Data pairs the ISR writes
+//* Input Parameters    : const volatile ADC_Pair *Source = ADC_DataXxx
+//* Output Parameters   : ADC_Pair = Value and Pack from the same ISR pass
+//*--------------------------------------------------------------------------------------
+
+ADC_Pair ADC_ReadPair(const volatile ADC_Pair *Source)
+{
+	ADC_Pair Pair;
+
+	SNAPSHOT_READ(ADC_PairCount, Pair, *Source);
+
+	return Pair;
+}
\ No newline at end of file
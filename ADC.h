@@ -11,13 +11,33 @@
 #ifndef ADC_H
 #define ADC_H
 
-//#defines for Analog Inputs
+//#defines for Analog Inputs (ADC0 MUXPOS)
 #define ADC_CHAN_EXT_IN			3
 #define ADC_CHAN_DC_IN			2
 #define ADC_CHAN_BAT1			1
 #define ADC_CHAN_BAT2			4
 #define ADC_CHAN_BAT3			5
 
+//ADC1 MUXPOS, PA7 is AIN3 on ADC1
+#define ADC1_CHAN_BATT_SENSE	3	// pack divider on PA7, the same input AC0 watches
+
+//Board option.  The BAT2/BAT3 taps and the PB5 tap enable share pins with the charger
+//PWR_GOOD input, the AC and the red LED on this board, so only scan them where fitted.
+//With them Cell.c watches each cell, a whole pass (DC_IN and BAT1-3) takes 4 ticks; ADC1
+//still reads the pack on every tick so the pack protection is not slowed
+#define ADC_CELL_TAPS_FITTED	0
+
+//Sampling.  ADC0 (scanning the inputs above) and ADC1 (pack) both start on the same
+//event channel so every ADC0 result has a pack reading taken at the same instant
+#define ADC_TRIGGER_GEN			EVSYS_SYNCCH0_TCB1_gc		// main loop tick, 1024 pairs a second
+#define ADC_DECIMATE(acc)		((acc) >> 2)				// 16 x 10 bit accumulation -> 12 bit result
+#define ADC_SINGLE(res)			((res) << 2)				// one 10 bit sample (EXT_IN) -> 12 bit scale
+
+//Pack window, EVENT_ADC_WINDOW is posted when the ADC1 reading goes below ADC_WINDOW_LOW_CNT
+//and again when it is back above it by ADC_WINDOW_HYST
+#define ADC_WINDOW_LOW_CNT		0x270		// 12 bit, the low battery level
+#define ADC_WINDOW_HYST			16
+
 #define ADC_ENA_CHANNELS_PORT	PORTB
 #define ADC_ENA_CHANNELS_PIN	5
 #define ADC_ENA_CHANNELS_BIT	(1 << ADC_ENA_CHANNELS_PIN)
@@ -48,8 +68,24 @@
 #define ADC_CHAN_BAT3_CTRL		PORTA.PIN5CTRL
 
 
+typedef struct
+{
+	uint16_t Value;		// 12 bit reading of the ADC0 input
+	uint16_t Pack;		// 12 bit pack reading from ADC1 taken on the same trigger
+} ADC_Pair;
+
 void ADC_Init(void);
-void ADC_Update(void);
-int ADC_ReadPin(uint8_t ain);
+void ADC_Power(uint8_t On);
+uint8_t ADC_BattSenseUpdate(uint8_t *LastCount, uint16_t *Battery);
+uint8_t ADC_ScanUpdate(uint8_t *LastCount);
+ADC_Pair ADC_ReadPair(const volatile ADC_Pair *Source);
+
+//written by the ADC ISRs, read them through ADC_ReadPair() / ADC_BattSenseUpdate()
+extern volatile ADC_Pair ADC_DataExternalInput;
+extern volatile ADC_Pair ADC_DataDCInput;
+extern volatile ADC_Pair ADC_DataBattery1;
+extern volatile ADC_Pair ADC_DataBattery2;
+extern volatile ADC_Pair ADC_DataBattery3;
+extern volatile uint16_t ADC_DataBattSense;
 
 #endif /* ADC_H */
\ No newline at end of file
@@ -0,0 +1,207 @@
+/*****************************************************************************************
+**
+**  Cell.c
+**
+**  Per cell battery monitor for Tiny1616
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#include <avr/io.h>
+#include "Cell.h"
+#include "ADC.h"
+#include "Horn.h"
+#include "Timer.h"
+
+//Per cell filtered mV, [CellLoad][cell]
+uint16_t CellVolts[2][CELL_COUNT];
+uint8_t CellValid[2];			// there has been a pass, telemetry keeps the last one
+uint8_t CellSeed[2];			// restart the filter from the next pass
+uint8_t CellScanCount;
+uint8_t CellDriving;			// Horn_IsDriving() on the last pass
+uint16_t CellIdleTick;			// RTC tick the horn went off
+uint8_t CellRested;				// off for CELL_REST_MS
+
+const volatile ADC_Pair * const CellTaps[CELL_COUNT] = { &ADC_DataBattery1, &ADC_DataBattery2, &ADC_DataBattery3 };
+const uint16_t CellTapFull_mV[CELL_COUNT] = { CELL_TAP1_FULL_MV, CELL_TAP2_FULL_MV, CELL_TAP3_FULL_MV };
+
+//local Functions
+static void Cell_Filter(uint8_t Load, const uint16_t *mV);
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Cell_Update()
+//* Object              : once a tick, take a whole new pass of the taps when there is one
+//*                       and file it as loaded or rested.  ADC_CELL_TAPS_FITTED only
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = CellLoad the new pass went into, CELL_NONE if none did
+//*--------------------------------------------------------------------------------------
+
+uint8_t Cell_Update(void)
+{
+#if ADC_CELL_TAPS_FITTED
+	uint8_t Driving = Horn_IsDriving();
+
+	if(Driving != CellDriving)
+	{
+		CellDriving = Driving;
+		CellSeed[Driving ? CELL_LOADED : CELL_RESTED] = 1;
+		CellRested = 0;
+		CellIdleTick = RTC_getTick();
+	}
+
+	if(!Driving && !CellRested && RTC_elapsedMS(CellIdleTick) >= CELL_REST_MS)
+	{
+		CellRested = 1;
+	}
+
+	if(!ADC_ScanUpdate(&CellScanCount))
+	{
+		return CELL_NONE;
+	}
+
+	ADC_Pair Taps[CELL_COUNT];
+	uint16_t mV[CELL_COUNT];
+	uint16_t Below = 0;
+
+	for (uint8_t i = 0; i < CELL_COUNT; i++)
+	{
+		Taps[i] = ADC_ReadPair(CellTaps[i]);
+	}
+
+	// each tap at the pack level of the newest, then the cell is the step from the tap below
+	for (uint8_t i = 0; i < CELL_COUNT; i++)
+	{
+		uint32_t Tap = (uint32_t)Taps[i].Value * CellTapFull_mV[i] >> 12;
+
+		if(Taps[i].Pack)
+		{
+			Tap = Tap * Taps[CELL_COUNT - 1].Pack / Taps[i].Pack;
+		}
+
+		mV[i] = (Tap > Below) ? Tap - Below : 0;
+		Below = Tap;
+	}
+
+	if(Driving)
+	{
+		Cell_Filter(CELL_LOADED, mV);
+		return CELL_LOADED;
+	}
+
+	if(CellRested)
+	{
+		Cell_Filter(CELL_RESTED, mV);
+		return CELL_RESTED;
+	}
+
+	return CELL_NONE;
+#else
+	return CELL_NONE;
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Cell_Filter()
+//* Object              : low pass one pass into the loaded or rested readings, the first
+//*                       pass of each honk or rest is taken as it is
+//* Input Parameters    : uint8_t Load = CellLoad, const uint16_t *mV = CELL_COUNT cells
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Cell_Filter(uint8_t Load, const uint16_t *mV)
+{
+	for (uint8_t i = 0; i < CELL_COUNT; i++)
+	{
+		if(CellValid[Load] && !CellSeed[Load])
+		{
+			CellVolts[Load][i] += ((int16_t)(mV[i] - CellVolts[Load][i])) >> CELL_FILTER_SHIFT;
+		}
+		else
+		{
+			CellVolts[Load][i] = mV[i];
+		}
+	}
+
+	CellValid[Load] = 1;
+	CellSeed[Load] = 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Cell_Read()
+//* Object              : one cell's filtered voltage
+//* Input Parameters    : uint8_t Load = CellLoad, uint8_t Cell = 0 bottom of the pack
+//* Output Parameters   : uint16_t = mV, 0 if there is no reading
+//*--------------------------------------------------------------------------------------
+
+uint16_t Cell_Read(uint8_t Load, uint8_t Cell)
+{
+	if(Load > CELL_RESTED || Cell >= CELL_COUNT || !CellValid[Load])
+	{
+		return 0;
+	}
+
+	return CellVolts[Load][Cell];
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Cell_Weakest()
+//* Object              : the lowest cell
+//* Input Parameters    : uint8_t Load = CellLoad
+//* Output Parameters   : uint8_t = cell index, CELL_NONE if there is no reading
+//*--------------------------------------------------------------------------------------
+
+uint8_t Cell_Weakest(uint8_t Load)
+{
+	if(Load > CELL_RESTED || !CellValid[Load])
+	{
+		return CELL_NONE;
+	}
+
+	uint8_t Weakest = 0;
+
+	for (uint8_t i = 1; i < CELL_COUNT; i++)
+	{
+		if(CellVolts[Load][i] < CellVolts[Load][Weakest])
+		{
+			Weakest = i;
+		}
+	}
+
+	return Weakest;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Cell_Imbalance()
+//* Object              : spread between the highest and lowest rested cell, the loaded
+//*                       spread is mostly the cells' internal resistance
+//* Input Parameters    : none
+//* Output Parameters   : uint16_t = mV, 0 until there is a rested reading
+//*--------------------------------------------------------------------------------------
+
+uint16_t Cell_Imbalance(void)
+{
+	uint8_t Weakest = Cell_Weakest(CELL_RESTED);
+
+	if(Weakest == CELL_NONE)
+	{
+		return 0;
+	}
+
+	uint16_t Highest = 0;
+
+	for (uint8_t i = 0; i < CELL_COUNT; i++)
+	{
+		if(CellVolts[CELL_RESTED][i] > Highest)
+		{
+			Highest = CellVolts[CELL_RESTED][i];
+		}
+	}
+
+	return Highest - CellVolts[CELL_RESTED][Weakest];
+}
@@ -0,0 +1,52 @@
+/*****************************************************************************************
+**
+**  Cell.h
+**
+**  Per cell battery monitor for Tiny1616
+**  works out each cell of the series pack from the BAT1-BAT3 taps so the horn cutoff and the
+**  low battery warning can follow the weakest cell instead of the whole pack
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef CELL_H
+#define CELL_H
+
+#include <avr/io.h>
+#include "ADC.h"
+
+//Taps.  BAT1-BAT3 are the tops of cells 1-3, each through its own divider to the 1.1V ADC0
+//reference.  Set the full scale (tap mV at a 4096 count reading) for the fitted resistors.
+//The three taps are read a few ticks apart, so each is scaled to the pack level of the
+//newest one using the ADC1 reading taken with it before the cells are differenced.
+#define CELL_COUNT			3
+#define CELL_TAP1_FULL_MV	4620UL
+#define CELL_TAP2_FULL_MV	9240UL
+#define CELL_TAP3_FULL_MV	13860UL
+
+//Loaded readings are the passes taken while Horn_IsDriving(), rested ones the passes taken
+//once the horn has been off CELL_REST_MS.  Each is low passed over 2^CELL_FILTER_SHIFT passes
+//(~31mS) and starts again from the first pass of each honk or rest.
+#define CELL_FILTER_SHIFT	2
+#define CELL_REST_MS		500
+
+//Limits, on the weakest cell, for LowVoltKill.c
+#define CELL_CUTOFF_MV		3000	// loaded, the honk ends and low battery is flagged
+#define CELL_LOW_MV			3300	// loaded, scores like a low AC0 sample (LOW_VOLT_LOW_BATT_DAC_CNT)
+#define CELL_REST_LOW_MV	3450	// rested, scores like a low parked sample
+
+#define CELL_NONE			0xFF	// no pass from Cell_Update(), no reading for Cell_Weakest()
+
+typedef enum {
+	CELL_LOADED,	// 0
+	CELL_RESTED		// 1
+} CellLoad;
+
+//Prototypes
+uint8_t Cell_Update(void);
+uint16_t Cell_Read(uint8_t Load, uint8_t Cell);
+uint8_t Cell_Weakest(uint8_t Load);
+uint16_t Cell_Imbalance(void);
+
+#endif /* CELL_H */
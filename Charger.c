@@ -10,6 +10,25 @@
 
 #include <avr/io.h>
 #include "Charger.h"
+#include "Gpio.h"
+#include "Event.h"
+#include "Diag.h"
+#include "Timer.h"
+#include "ADC.h"
+#include "Led.h"
+#include "Horn.h"
+#include "Energy.h"
+#include "LowVoltKill.h"
+#include <avr/interrupt.h>
+
+uint8_t ChargerLowSpeed;		// 1 while on the charger at 32kHz
+uint8_t ChargerTicks;			// ticks taken since the last Charger_sleep()
+uint16_t ChargerCyclesMax;
+uint16_t ChargerOverruns;
+
+//local Functions
+static void Charger_exit(void);
+static void Charger_led(void);
 
 
 //*--------------------------------------------------------------------------------------
@@ -21,11 +40,214 @@
 
 void Charger_init(void)
 {
-	CHARGER_PWR_GOOD_PORT.DIRCLR = CHARGER_PWR_GOOD_BIT;
-	CHARGER_PWR_GOOD_PORT.OUTSET = CHARGER_PWR_GOOD_BIT;
-	CHARGER_PWR_GOOD_CTRL = PORT_PULLUPEN_bm;
+	GPIO_INPUT(CHARGER_PWR_GOOD);
+	GPIO_SET(CHARGER_PWR_GOOD);
+	CHARGER_PWR_GOOD_CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
 	
-	CHARGER_STATUS_PORT.DIRCLR = CHARGER_STATUS_BIT;
-	CHARGER_STATUS_PORT.OUTSET = CHARGER_STATUS_BIT;
-	CHARGER_STATUS_CTRL = PORT_PULLUPEN_bm;
+	GPIO_INPUT(CHARGER_STATUS);
+	GPIO_SET(CHARGER_STATUS);
+	CHARGER_STATUS_CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Charger_enter()
+//* Object              : plugged in, drop to the 32kHz clock and the charging loop
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Charger_enter(void)
+{
+	Sound_Kill(1);
+	LowVoltKill_analogPower(0);
+	ADC_Power(0);
+
+	// source first then the prescaler off, CLK_PER never runs OSC20M undivided.
+	// Charger_exit() puts the /2 back before it selects OSC20M again
+	_PROTECTED_WRITE(CLKCTRL.MCLKCTRLA, CLKCTRL_CLKSEL_OSCULP32K_gc);
+	_PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, 0);
+	Timer_tickSlow(1);
+
+	ChargerLowSpeed = 1;
+	ChargerTicks = 0;
+
+	Charger_led();
+	Energy_Update(ENERGY_CHARGING);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Charger_exit()
+//* Object              : unplugged, back to full speed, Main_Update() runs from the next
+//*                       event on
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Charger_exit(void)
+{
+	Energy_Update(ENERGY_CHARGING);
+
+	_PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, CLKCTRL_PEN_bm | (0 << CLKCTRL_PDIV0_bp));
+	_PROTECTED_WRITE(CLKCTRL.MCLKCTRLA, CLKCTRL_CLKSEL_OSC20M_gc);
+	Timer_tickSlow(0);
+
+	ADC_Power(1);
+	LED_Red(0);
+	LED_Green(0);
+	Sound_Kill(0);
+
+	ChargerLowSpeed = 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Charger_event()
+//* Object              : the charging loop, every event while ChargerLowSpeed is set comes
+//*                       here.  Written to the estimated tick budget in Charger.h, still
+//*                       open, nothing in here polls
+//* Input Parameters    : const Event *Ev = event from the queue
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Charger_event(const Event *Ev)
+{
+	switch (Ev->Type)
+	{
+		case EVENT_TICK:
+		{
+			ChargerTicks++;
+			Energy_Update(ENERGY_CHARGING);
+			break;
+		}
+
+		case EVENT_CHARGER:
+		{
+			if(Ev->Data)
+			{
+				Charger_led();
+			}
+			else
+			{
+				Charger_exit();
+			}
+			break;
+		}
+
+		// horn switch, buttons and the pack monitors wait until unplugged
+		default:
+		{
+			break;
+		}
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Charger_sleep()
+//* Object              : measure the pass just finished, called by main() with the queue
+//*                       empty just before it sleeps.  TCB1 has counted CLK_PER / 2 since
+//*                       the tick that woke it
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Charger_sleep(void)
+{
+	uint16_t Cycles = TCB1.CNT * 2;
+
+	if(ChargerTicks > 1)
+	{
+		if(ChargerOverruns < 0xFFFF)
+		{
+			ChargerOverruns++;
+		}
+	}
+	else if(ChargerTicks && Cycles > ChargerCyclesMax)
+	{
+		ChargerCyclesMax = Cycles;
+	}
+
+	ChargerTicks = 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Charger_stat()
+//* Object              : charging loop figures
+//* Input Parameters    : uint8_t Which = ChargerStat
+//* Output Parameters   : uint16_t = value, 0 for an unknown Which
+//*--------------------------------------------------------------------------------------
+
+uint16_t Charger_stat(uint8_t Which)
+{
+	if(Which == CHARGER_STAT_CYCLES_MAX)
+	{
+		return ChargerCyclesMax;
+	}
+
+	if(Which == CHARGER_STAT_OVERRUNS)
+	{
+		return ChargerOverruns;
+	}
+
+	return 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Charger_led()
+//* Object              : charge status on the LEDs, red charging, green done
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Charger_led(void)
+{
+	if(!GPIO_READ(CHARGER_STATUS))
+	{
+		LED_Red(1);
+		LED_Green(0);
+	}
+	else
+	{
+		LED_Red(0);
+		LED_Green(1);
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ISR(PORTA_PORT_vect), ISR(PORTC_PORT_vect)
+//* Object              : charger PWR_GOOD / STATUS edge, the only pin interrupts on these
+//*                       ports
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+ISR(PORTA_PORT_vect)
+{
+	DIAG_ISR_ENTER();
+
+	uint8_t Flags = VPORTA.INTFLAGS;
+	VPORTA.INTFLAGS = Flags;
+
+	if(Flags & CHARGER_PWR_GOOD_BIT)
+	{
+		Event_Post(EVENT_CHARGER, !GPIO_READ(CHARGER_PWR_GOOD));
+	}
+}
+
+ISR(PORTC_PORT_vect)
+{
+	DIAG_ISR_ENTER();
+
+	uint8_t Flags = VPORTC.INTFLAGS;
+	VPORTC.INTFLAGS = Flags;
+
+	if(Flags & CHARGER_STATUS_BIT)
+	{
+		Event_Post(EVENT_CHARGER, !GPIO_READ(CHARGER_PWR_GOOD));
+	}
 }
@@ -11,6 +11,9 @@
 #ifndef CHARGER_H
 #define CHARGER_H
 
+#include <avr/io.h>
+#include "Event.h"
+
 //defines for charger I/O pins
 #define CHARGER_PWR_GOOD_PORT	PORTA
 #define CHARGER_PWR_GOOD_PIN	4
@@ -22,7 +25,43 @@
 #define CHARGER_STATUS_BIT		(1 << CHARGER_STATUS_PIN)
 #define CHARGER_STATUS_CTRL		PORTC.PIN1CTRL
 
+//Charging mode.  On the charger the CPU runs from OSCULP32K with the prescaler off, so
+//CLK_PER is TIMER_TICK_SLOW_CLK, 32 cycles a mS.  The 1024Hz tick is dropped to
+//TIMER_TICK_SLOW_HZ and the main loop hands every event to Charger_event() instead of
+//Main_Update().  Only the PWR_GOOD / STATUS edges and the tick
+//are acted on, the horn is held off and the ADCs are stopped.  Timing all comes from
+//RTC.CNT, which keeps real time on its own 1kHz clock whatever CLK_PER is.
+//
+//Budget, 32768 / 32 = 1024 CPU cycles a tick.  Hand estimate of the worst tick, -Os:
+//   wake from IDLE and interrupt response                  ~10
+//   ISR(TCB1_INT_vect), push / pop, DIAG, Event_Post       ~150
+//   Event_Get, Charger_event() dispatch                    ~70
+//   Energy_Update(), 32 bit multiply and both carry loops  ~250
+//   a PWR_GOOD or STATUS edge in the same tick: ISR,
+//   Event_Get, pin read and two LED writes                 ~250
+//   Charger_sleep() and the sleep entry in main()          ~40
+//                                                          ~770, 75% of the tick
+//OPEN: the budget is unverified.  The figures above are counted by hand from the source, not
+//read off a listing, a simulator or a unit, and nothing here shows the tick fits.  Replace
+//them with DIAG_CHARGE_CYCLES_MAX and DIAG_CHARGE_OVERRUNS read from a unit that has sat on
+//the charger through an hourly snapshot: CHARGER_STAT_CYCLES_MAX is the most CPU cycles from
+//a tick to sleeping again and CHARGER_STAT_OVERRUNS counts passes that ran into the next
+//tick.  Energy_Update()'s hourly EEPROM snapshot goes out a byte a tick and never waits on
+//the NVM, so at least no NVM wait is added to the tick.
+
+typedef enum {
+	CHARGER_STAT_CYCLES_MAX,	// 0 most CPU cycles from a tick to sleeping, at 32kHz
+	CHARGER_STAT_OVERRUNS		// 1 passes that took more than one tick, sticks at 65535
+} ChargerStat;
+
 //Prototypes
 void Charger_init(void);
+void Charger_enter(void);
+void Charger_event(const Event *Ev);
+void Charger_sleep(void);
+uint16_t Charger_stat(uint8_t Which);
+
+// External variable declarations
+extern uint8_t ChargerLowSpeed;
 
 #endif /* CHARGER_H */
\ No newline at end of file
@@ -0,0 +1,207 @@
+/*****************************************************************************************
+**
+**  Diag.c
+**
+**  Diagnostics for Tiny1616
+**  stack painting, stack high water and the interrupt stack
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#include <avr/io.h>
+#include "Diag.h"
+#include "Horn.h"
+#include "Event.h"
+#include "Charger.h"
+#include "Sag.h"
+#include "Cell.h"
+
+//Linker symbols, end of .bss (start of free RAM) and the top of the stack
+extern uint8_t _end;
+extern uint8_t __stack;
+
+volatile uint16_t DiagIsrSPMin = RAMEND;
+SnapshotSeq DiagIsrSeq;			// published when DiagIsrSPMin changes
+
+void Diag_StackPaint(void) __attribute__((naked, used, section(".init3")));
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Diag_StackPaint()
+//* Object              : fill free RAM with DIAG_STACK_CANARY before main() runs.  Lives in
+//*                       .init3, after the stack pointer is set and before .data/.bss are
+//*                       loaded, naked so nothing is pushed onto the stack being painted
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Diag_StackPaint(void)
+{
+	uint8_t *p = &_end;
+
+	while (p <= &__stack)
+	{
+		*p++ = DIAG_STACK_CANARY;
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Diag_StackFree()
+//* Object              : stack high water, count the painted bytes nothing has written
+//* Input Parameters    : none
+//* Output Parameters   : uint16_t = bytes of stack never used since reset
+//*--------------------------------------------------------------------------------------
+
+uint16_t Diag_StackFree(void)
+{
+	const uint8_t *p = &_end;
+	uint16_t Free = 0;
+
+	while (p <= &__stack && *p == DIAG_STACK_CANARY)
+	{
+		p++;
+		Free++;
+	}
+
+	return Free;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Diag_Read()
+//* Object              : read one diagnostic figure
+//* Input Parameters    : uint8_t Id = DiagId
+//* Output Parameters   : uint32_t = value, 0 for an unknown Id
+//*--------------------------------------------------------------------------------------
+
+uint32_t Diag_Read(uint8_t Id)
+{
+	if(Id >= DIAG_ENERGY_UAH && Id < DIAG_ENERGY_SECONDS)
+	{
+		return Energy_Read(ENERGY_READ_UAH, Id - DIAG_ENERGY_UAH);
+	}
+
+	if(Id >= DIAG_ENERGY_SECONDS && Id < DIAG_CHARGE_CYCLES_MAX)
+	{
+		return Energy_Read(ENERGY_READ_SECONDS, Id - DIAG_ENERGY_SECONDS);
+	}
+
+	if(Id >= DIAG_CELL_LOADED_MV && Id < DIAG_CELL_RESTED_MV)
+	{
+		return Cell_Read(CELL_LOADED, Id - DIAG_CELL_LOADED_MV);
+	}
+
+	if(Id >= DIAG_CELL_RESTED_MV && Id < DIAG_CELL_WEAKEST)
+	{
+		return Cell_Read(CELL_RESTED, Id - DIAG_CELL_RESTED_MV);
+	}
+
+	switch (Id)
+	{
+		case DIAG_STACK_FREE:
+		{
+			return Diag_StackFree();
+		}
+
+		case DIAG_STACK_SIZE:
+		{
+			return (uint16_t)(&__stack - &_end) + 1;
+		}
+
+		case DIAG_STATIC_RAM:
+		{
+			return (uint16_t)(&_end - (uint8_t *)RAMSTART);
+		}
+
+		case DIAG_ISR_SP_MIN:
+		{
+			uint16_t SPMin;
+
+			SNAPSHOT_READ(DiagIsrSeq, SPMin, DiagIsrSPMin);
+			return SPMin;
+		}
+
+		case DIAG_HORN_BUDGET:
+		{
+			return Horn_BudgetRead(HORN_BUDGET_SCALE);
+		}
+
+		case DIAG_HORN_HEAT:
+		{
+			return Horn_BudgetRead(HORN_BUDGET_HEAT);
+		}
+
+		case DIAG_HORN_ENERGY:
+		{
+			return Horn_BudgetRead(HORN_BUDGET_ENERGY);
+		}
+
+		case DIAG_EVENT_HIGH_WATER:
+		{
+			return Event_Stat(EVENT_STAT_HIGH_WATER);
+		}
+
+		case DIAG_EVENT_LATENCY_MAX:
+		{
+			return Event_Stat(EVENT_STAT_LATENCY_MAX);
+		}
+
+		case DIAG_EVENT_DROPPED:
+		{
+			return Event_Stat(EVENT_STAT_DROPPED);
+		}
+
+		case DIAG_CHARGE_CYCLES_MAX:
+		{
+			return Charger_stat(CHARGER_STAT_CYCLES_MAX);
+		}
+
+		case DIAG_CHARGE_OVERRUNS:
+		{
+			return Charger_stat(CHARGER_STAT_OVERRUNS);
+		}
+
+		case DIAG_SAG_COUNT:
+		{
+			return Sag_Stat(SAG_STAT_COUNT);
+		}
+
+		case DIAG_SAG_WIDTH_MAX:
+		{
+			return Sag_Stat(SAG_STAT_WIDTH_MAX);
+		}
+
+		case DIAG_SAG_RIPPLE:
+		{
+			return Sag_Stat(SAG_STAT_RIPPLE);
+		}
+
+		case DIAG_SAG_LAST:
+		{
+			SagRecord Sag;
+
+			if(!Sag_Read(0, &Sag))
+			{
+				return 0;
+			}
+			return Sag.Width_uS | ((uint32_t)Sag.SinceHorn_mS << 16);
+		}
+
+		case DIAG_CELL_WEAKEST:
+		{
+			return Cell_Weakest(CELL_RESTED);
+		}
+
+		case DIAG_CELL_IMBALANCE_MV:
+		{
+			return Cell_Imbalance();
+		}
+
+		default:
+		{
+			return 0;
+		}
+	}
+}
\ No newline at end of file
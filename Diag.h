@@ -0,0 +1,59 @@
+/*****************************************************************************************
+**
+**  Diag.h
+**
+**  Diagnostics for Tiny1616
+**  one read path, Diag_Read(), for the figures we want to see from a unit
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <avr/io.h>
+#include "Snapshot.h"
+#include "Energy.h"
+#include "Cell.h"
+
+#define DIAG_STACK_CANARY		0xC5	// painted over free RAM at reset
+
+typedef enum {
+	DIAG_STACK_FREE,		// 0 bytes of stack never touched since reset (headroom)
+	DIAG_STACK_SIZE,		// 1 bytes from the end of static RAM to the top of RAM
+	DIAG_STATIC_RAM,		// 2 bytes of .data + .bss
+	DIAG_ISR_SP_MIN,		// 3 lowest stack pointer seen on interrupt entry
+	DIAG_HORN_BUDGET,		// 4 HORN_ON duty scale left in the drive budget, 256 = 1.0
+	DIAG_HORN_HEAT,			// 5 horn heat integral >> 10
+	DIAG_HORN_ENERGY,		// 6 this honk's energy integral >> 10
+	DIAG_EVENT_HIGH_WATER,	// 7 most events ever waiting in the queue
+	DIAG_EVENT_LATENCY_MAX,	// 8 longest event post to dispatch, in ticks
+	DIAG_EVENT_DROPPED,		// 9 events lost to a full queue
+	DIAG_ENERGY_UAH,		// 10-14 lifetime uAh used in each EnergyState, + state
+	DIAG_ENERGY_SECONDS = DIAG_ENERGY_UAH + ENERGY_STATE_COUNT,	// 15-19 lifetime seconds in each EnergyState, + state
+	DIAG_CHARGE_CYCLES_MAX = DIAG_ENERGY_SECONDS + ENERGY_STATE_COUNT,	// 20 most cycles a charging tick took
+	DIAG_CHARGE_OVERRUNS,	// 21 charging passes that ran into the next tick
+	DIAG_SAG_COUNT,			// 22 pack sags of SAG_MIN_US or more logged
+	DIAG_SAG_WIDTH_MAX,		// 23 longest sag, uS
+	DIAG_SAG_RIPPLE,		// 24 excursions too short to log, carrier ripple
+	DIAG_SAG_LAST,			// 25 newest sag, Width_uS | SinceHorn_mS << 16, 0 = none
+	DIAG_CELL_LOADED_MV,	// 26-28 each cell while the horn drives, bottom first, 0 = no taps
+	DIAG_CELL_RESTED_MV = DIAG_CELL_LOADED_MV + CELL_COUNT,	// 29-31 each cell at rest
+	DIAG_CELL_WEAKEST = DIAG_CELL_RESTED_MV + CELL_COUNT,	// 32 weakest rested cell, CELL_NONE = no reading
+	DIAG_CELL_IMBALANCE_MV,	// 33 highest less lowest rested cell
+	DIAG_COUNT				// 34
+} DiagId;
+
+//Interrupt stack, DIAG_ISR_ENTER() first thing in every ISR.  All interrupts here are LVL0 and
+//none re-enable them, so ISRs never nest and the deepest stack is one ISR on top of main
+#define DIAG_ISR_ENTER()	do { if(SP < DiagIsrSPMin) { DiagIsrSPMin = SP; SNAPSHOT_PUBLISH(DiagIsrSeq); } } while (0)
+
+extern volatile uint16_t DiagIsrSPMin;
+extern SnapshotSeq DiagIsrSeq;
+
+//Prototypes
+uint16_t Diag_StackFree(void);
+uint32_t Diag_Read(uint8_t Id);
+
+#endif /* DIAG_H */
@@ -0,0 +1,220 @@
+/*****************************************************************************************
+**
+**  Energy.c
+**
+**  Per state energy accounting for Tiny1616
+**  cumulative over the life of the unit, saved to EEPROM every ENERGY_SNAPSHOT_S while idle
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "Energy.h"
+#include "Timer.h"
+
+//Two copies of the log.  A save goes to the slot not holding the newest good log, so a reset
+//part way through a save leaves that one whole, and boot takes the newest slot that checks
+EnergyLog EEMEM EnergyEeprom[ENERGY_SLOTS];
+
+EnergyLog EnergyTotals;
+uint32_t EnergyFrac[ENERGY_STATE_COUNT];	// uA x ticks not yet a whole uAh
+uint16_t EnergyTicks[ENERGY_STATE_COUNT];	// ticks not yet a whole second
+uint16_t EnergyOldTick;
+uint16_t EnergySnapshotTimer_S;
+EnergyLog EnergySave;						// snapshot being written to EEPROM
+uint8_t EnergySaveLeft;						// bytes of it still to write, 0 = none
+uint8_t EnergySaveSlot;						// slot the next save goes to
+
+const uint32_t EnergyCurrent_uA[ENERGY_STATE_COUNT] =
+{
+	[ENERGY_IDLE]		= ENERGY_IDLE_UA,
+	[ENERGY_CHARGING]	= ENERGY_CHARGING_UA,
+	[ENERGY_HORN]		= ENERGY_HORN_UA,
+	[ENERGY_BELL]		= ENERGY_BELL_UA,
+	[ENERGY_DEAD]		= ENERGY_DEAD_UA,
+};
+
+//local Functions
+static uint16_t Energy_Check(const EnergyLog *Log);
+static void Energy_SaveByte(void);
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Energy_Check()
+//* Object              : check word for a saved log
+//* Input Parameters    : const EnergyLog *Log
+//* Output Parameters   : uint16_t = ENERGY_CHECK_SEED + sum of the counters and Seq
+//*--------------------------------------------------------------------------------------
+
+static uint16_t Energy_Check(const EnergyLog *Log)
+{
+	uint16_t Sum = ENERGY_CHECK_SEED + Log->Seq;
+
+	for(uint8_t i = 0; i < ENERGY_STATE_COUNT; i++)
+	{
+		Sum += (uint16_t)Log->uAh[i] + (uint16_t)(Log->uAh[i] >> 16);
+		Sum += (uint16_t)Log->Seconds[i] + (uint16_t)(Log->Seconds[i] >> 16);
+	}
+
+	return Sum;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Energy_SaveByte()
+//* Object              : write the next byte of the snapshot, unless the NVM is still busy
+//*                       with the last one.  The page erase and write runs on in the NVM
+//*                       controller, so this never waits on it.  The slot changes over once
+//*                       the whole log is in
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Energy_SaveByte(void)
+{
+	if(NVMCTRL.STATUS & NVMCTRL_EEBUSY_bm)
+	{
+		return;
+	}
+
+	uint8_t i = sizeof(EnergyLog) - EnergySaveLeft;
+
+	eeprom_update_byte((uint8_t *)&EnergyEeprom[EnergySaveSlot] + i, ((const uint8_t *)&EnergySave)[i]);
+
+	if(--EnergySaveLeft == 0)
+	{
+		EnergySaveSlot ^= 1;
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Energy_Init()
+//* Object              : pick up the newest good totals saved in EEPROM, or start from 0,
+//*                       and aim the next save at the other slot
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Energy_Init(void)
+{
+	EnergyLog Log;
+	uint8_t Found = 0;
+
+	for(uint8_t Slot = 0; Slot < ENERGY_SLOTS; Slot++)
+	{
+		eeprom_read_block(&Log, &EnergyEeprom[Slot], sizeof(EnergyLog));
+
+		if(Log.Check != Energy_Check(&Log))
+		{
+			continue;
+		}
+
+		// Seq wraps, the newer of two is the one a short way ahead
+		if(!Found || (int8_t)(Log.Seq - EnergyTotals.Seq) > 0)
+		{
+			EnergyTotals = Log;
+			EnergySaveSlot = Slot ^ 1;
+			Found = 1;
+		}
+	}
+
+	if(!Found)
+	{
+		for(uint8_t i = 0; i < ENERGY_STATE_COUNT; i++)
+		{
+			EnergyTotals.uAh[i] = 0;
+			EnergyTotals.Seconds[i] = 0;
+		}
+		EnergyTotals.Seq = 0;
+		EnergySaveSlot = 0;
+	}
+
+	EnergyOldTick = RTC_getTick();
+	EnergySnapshotTimer_S = ENERGY_SNAPSHOT_S;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Energy_Update()
+//* Object              : charge the ticks since the last call to State.  Called at least
+//*                       once a tick, 1024 a second at 8MHz and 32 a second at 32kHz
+//* Input Parameters    : uint8_t State = EnergyState the unit is in
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Energy_Update(uint8_t State)
+{
+	uint16_t Elapsed = RTC_elapsedMS(EnergyOldTick);
+
+	if(Elapsed == 0)
+	{
+		return;
+	}
+
+	EnergyOldTick += Elapsed;
+
+	if(Elapsed > ENERGY_MAX_STEP)
+	{
+		Elapsed = ENERGY_MAX_STEP;
+	}
+
+	// largest step is 1.5A x 1024 ticks, well inside 32 bits
+	EnergyFrac[State] += EnergyCurrent_uA[State] * Elapsed;
+	while(EnergyFrac[State] >= ENERGY_TICKS_PER_HOUR)
+	{
+		EnergyFrac[State] -= ENERGY_TICKS_PER_HOUR;
+		EnergyTotals.uAh[State]++;
+	}
+
+	EnergyTicks[State] += Elapsed;
+	while(EnergyTicks[State] >= 1024)
+	{
+		EnergyTicks[State] -= 1024;
+		EnergyTotals.Seconds[State]++;
+
+		if(EnergySnapshotTimer_S)
+		{
+			EnergySnapshotTimer_S--;
+		}
+	}
+
+	// EEPROM only while nothing is sounding.  The totals are copied out whole with the next
+	// sequence number and their check word, and written a byte a pass so no pass waits on the NVM
+	if(State == ENERGY_IDLE || State == ENERGY_CHARGING)
+	{
+		if(EnergySaveLeft)
+		{
+			Energy_SaveByte();
+		}
+		else if(EnergySnapshotTimer_S == 0)
+		{
+			EnergyTotals.Seq++;
+			EnergySave = EnergyTotals;
+			EnergySave.Check = Energy_Check(&EnergySave);
+			EnergySaveLeft = sizeof(EnergyLog);
+			EnergySnapshotTimer_S = ENERGY_SNAPSHOT_S;
+		}
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Energy_Read()
+//* Object              : read a lifetime total, through Diag_Read()
+//* Input Parameters    : uint8_t Item = ENERGY_READ_UAH / ENERGY_READ_SECONDS,
+//*                       uint8_t State = EnergyState
+//* Output Parameters   : uint32_t = uAh or seconds
+//*--------------------------------------------------------------------------------------
+
+uint32_t Energy_Read(uint8_t Item, uint8_t State)
+{
+	if(State >= ENERGY_STATE_COUNT)
+	{
+		return 0;
+	}
+
+	return (Item == ENERGY_READ_UAH) ? EnergyTotals.uAh[State] : EnergyTotals.Seconds[State];
+}
\ No newline at end of file
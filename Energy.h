@@ -0,0 +1,58 @@
+/*****************************************************************************************
+**
+**  Energy.h
+**
+**  Per state energy accounting for Tiny1616
+**  time in each state from the RTC tick, times a modelled current, kept in EEPROM
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <avr/io.h>
+
+typedef enum {
+	ENERGY_IDLE,		// 0 awake at 8MHz, horn off
+	ENERGY_CHARGING,	// 1 on the charger at 32kHz
+	ENERGY_HORN,		// 2 HORN_ON
+	ENERGY_BELL,		// 3 a bell / beep sequence playing
+	ENERGY_DEAD,		// 4 LOW_VOLT_STATE_DEAD
+	ENERGY_STATE_COUNT	// 5
+} EnergyState;
+
+//Current model, uA drawn from the pack in each state.  Bench estimates for the MCU, ADCs and
+//horn driver, put measured figures in here when a board has been on the meter
+#define ENERGY_IDLE_UA			3000UL
+#define ENERGY_CHARGING_UA		50UL		// MCU only, the charger feeds the horn-side load
+#define ENERGY_HORN_UA			1500000UL	// sustain average
+#define ENERGY_BELL_UA			600000UL
+#define ENERGY_DEAD_UA			3000UL
+
+#define ENERGY_TICKS_PER_HOUR	3686400UL	// 1024 RTC ticks a second, uA x ticks per uAh
+#define ENERGY_MAX_STEP			1024		// most ticks counted in one update
+#define ENERGY_SNAPSHOT_S		3600		// EEPROM save period, ~9000 writes a year of endurance
+#define ENERGY_SLOTS			2			// saves alternate between the slots, each one ~4400 a year
+
+typedef struct
+{
+	uint32_t uAh[ENERGY_STATE_COUNT];		// charge used in each state
+	uint32_t Seconds[ENERGY_STATE_COUNT];	// time in each state
+	uint8_t Seq;							// one more than the save before, newest slot wins
+	uint16_t Check;							// ENERGY_CHECK_SEED + sum of the above
+} EnergyLog;
+
+#define ENERGY_CHECK_SEED		0xE6E7
+
+//Energy_Read() items
+#define ENERGY_READ_UAH			0
+#define ENERGY_READ_SECONDS		1
+
+//Prototypes
+void Energy_Init(void);
+void Energy_Update(uint8_t State);
+uint32_t Energy_Read(uint8_t Item, uint8_t State);
+
+#endif /* ENERGY_H */
\ No newline at end of file
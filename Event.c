@@ -0,0 +1,142 @@
+/*****************************************************************************************
+**
+**  Event.c
+**
+**  ISR to main loop event queue for Tiny1616
+**  single producer / single consumer ring, no interrupts are ever disabled
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#include <avr/io.h>
+#include "Event.h"
+
+//Only ISRs move EventHead and only the main loop moves EventTail, each index is one byte so
+//its reads and writes are atomic.  ISRs here do not nest, so all of them together are one
+//producer.  A level 1 interrupt that posts would break that.
+//The ring itself is not volatile, so the compiler is free to move slot reads and writes past
+//the volatile index on either side.  EVENT_BARRIER() keeps each slot access on its own side of
+//the index update that hands the slot over.
+#define EVENT_BARRIER()		__asm__ __volatile__("" ::: "memory")
+
+Event EventQueue[EVENT_QUEUE_SIZE];
+volatile uint8_t EventHead;			// next slot to fill, ISR side
+volatile uint8_t EventTail;			// next slot to take, main loop side
+volatile uint8_t EventTicks;		// bumped by the tick ISR, stamps events
+
+uint8_t EventHighWater;
+uint8_t EventLatencyMax;
+volatile uint8_t EventDropped;
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Event_Post()
+//* Object              : add an event, ISR side only
+//* Input Parameters    : uint8_t Type = EventType, uint8_t Data = event data
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Event_Post(uint8_t Type, uint8_t Data)
+{
+	uint8_t Head = EventHead;
+	uint8_t Count = Head - EventTail;
+
+	if(Count >= EVENT_QUEUE_SIZE)
+	{
+		if(EventDropped < 255)
+		{
+			EventDropped++;
+		}
+		return;
+	}
+
+	Event *Ev = &EventQueue[Head & EVENT_QUEUE_MASK];
+	Ev->Type = Type;
+	Ev->Data = Data;
+	Ev->Stamp = EventTicks;
+
+	if(++Count > EventHighWater)
+	{
+		EventHighWater = Count;
+	}
+
+	// the slot is written before the main loop can see it
+	EVENT_BARRIER();
+	EventHead = Head + 1;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Event_Get()
+//* Object              : take the oldest event, main loop only
+//* Input Parameters    : Event *Ev = where to copy it
+//* Output Parameters   : uint8_t = 1 if there was one
+//*--------------------------------------------------------------------------------------
+
+uint8_t Event_Get(Event *Ev)
+{
+	uint8_t Tail = EventTail;
+
+	if(Tail == EventHead)
+	{
+		return 0;
+	}
+
+	// the slot is only read once the head says it is full, and all of it is copied before an
+	// ISR can fill it again
+	EVENT_BARRIER();
+	*Ev = EventQueue[Tail & EVENT_QUEUE_MASK];
+	EVENT_BARRIER();
+	EventTail = Tail + 1;
+
+	uint8_t Latency = EventTicks - Ev->Stamp;
+	if(Latency > EventLatencyMax)
+	{
+		EventLatencyMax = Latency;
+	}
+
+	return 1;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Event_Pending()
+//* Object              : anything waiting, call with interrupts off before sleeping
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = 1 if the queue is not empty
+//*--------------------------------------------------------------------------------------
+
+uint8_t Event_Pending(void)
+{
+	return (EventHead != EventTail);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Event_Stat()
+//* Object              : queue statistics, read through Diag_Read()
+//* Input Parameters    : uint8_t Which = EventStat
+//* Output Parameters   : uint8_t = value
+//*--------------------------------------------------------------------------------------
+
+uint8_t Event_Stat(uint8_t Which)
+{
+	switch (Which)
+	{
+		case EVENT_STAT_HIGH_WATER:
+		{
+			return EventHighWater;
+		}
+
+		case EVENT_STAT_LATENCY_MAX:
+		{
+			return EventLatencyMax;
+		}
+
+		default:
+		{
+			return EventDropped;
+		}
+	}
+}
\ No newline at end of file
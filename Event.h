@@ -0,0 +1,55 @@
+/*****************************************************************************************
+**
+**  Event.h
+**
+**  ISR to main loop event queue for Tiny1616
+**  interrupts post small events, the main loop takes them off and sleeps when there are none
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <avr/io.h>
+
+//Queue size, a power of 2.  Ticks come every ~1mS and everything else is rarer, so this is
+//many mS of main loop stall before anything is dropped
+#define EVENT_QUEUE_SIZE	16
+#define EVENT_QUEUE_MASK	(EVENT_QUEUE_SIZE - 1)
+
+typedef enum {
+	EVENT_TICK,			// 0 TCB1 tick, Data unused
+	EVENT_SWITCH,		// 1 horn switch edge, Data = pin level
+	EVENT_SAG,			// 2 pack sag below the AC0 / DAC0 level ended, Data = Sag.c ring slot
+	EVENT_ADC_WINDOW,	// 3 ADC1 pack reading left the window, Data = 1 below, 0 back above
+	EVENT_CHARGER,		// 4 charger PWR_GOOD or STATUS edge, Data = 1 if PWR_GOOD is low (plugged)
+	EVENT_BUTTON		// 5 ladder button, Data = button | EVENT_BUTTON_PRESSED when pressed
+} EventType;
+
+#define EVENT_BUTTON_PRESSED	0x80
+
+typedef struct
+{
+	uint8_t Type;		// EventType
+	uint8_t Data;
+	uint8_t Stamp;		// EventTicks when posted, for the dispatch latency
+} Event;
+
+extern volatile uint8_t EventTicks;
+
+//Prototypes
+void Event_Post(uint8_t Type, uint8_t Data);
+uint8_t Event_Get(Event *Ev);
+uint8_t Event_Pending(void);
+uint8_t Event_Stat(uint8_t Which);
+
+//Event_Stat() values
+typedef enum {
+	EVENT_STAT_HIGH_WATER,	// 0 most events ever waiting
+	EVENT_STAT_LATENCY_MAX,	// 1 longest post to Event_Get(), in ticks
+	EVENT_STAT_DROPPED		// 2 events lost to a full queue, sticks at 255
+} EventStat;
+
+#endif /* EVENT_H */
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*****************************************************************************************
+**
+**  Gpio.h
+**
+**  Pin access for Tiny1616 through the VPORT registers
+**  takes the existing NAME_PORT / NAME_BIT pin #defines, ie GPIO_SET(LED_RED), and
+**  compiles down to single cycle SBI/CBI/SBIS/SBIC instead of PORTx.OUTSET/OUTCLR/IN
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <avr/io.h>
+
+//PORTn lives at 0x0400 + 0x20 * n and its VPORTn at 0x0000 + 4 * n, both addresses are
+//compile time constants so the bit instructions can be used
+#define GPIO_VPORT(port)		((VPORT_t *)((_SFR_MEM_ADDR(port) - _SFR_MEM_ADDR(PORTA)) >> 3))
+
+//Pin macros, pin is the name prefix of a NAME_PORT / NAME_BIT pair
+#define GPIO_SET(pin)			Gpio_Set(GPIO_VPORT(pin##_PORT), pin##_BIT)
+#define GPIO_CLR(pin)			Gpio_Clr(GPIO_VPORT(pin##_PORT), pin##_BIT)
+#define GPIO_TGL(pin)			Gpio_Tgl(GPIO_VPORT(pin##_PORT), pin##_BIT)
+#define GPIO_WRITE(pin, value)	Gpio_Write(GPIO_VPORT(pin##_PORT), pin##_BIT, (value))
+#define GPIO_READ(pin)			Gpio_Read(GPIO_VPORT(pin##_PORT), pin##_BIT)
+#define GPIO_OUTPUT(pin)		Gpio_Output(GPIO_VPORT(pin##_PORT), pin##_BIT)
+#define GPIO_INPUT(pin)			Gpio_Input(GPIO_VPORT(pin##_PORT), pin##_BIT)
+
+#define GPIO_INLINE				static inline __attribute__((always_inline))
+
+//*--------------------------------------------------------------------------------------
+//* Inline helpers, only ever called through the macros above so Port and Bit are
+//* constants and each one becomes a single bit instruction
+//*--------------------------------------------------------------------------------------
+
+GPIO_INLINE void Gpio_Set(VPORT_t *Port, uint8_t Bit)
+{
+	Port->OUT |= Bit;
+}
+
+GPIO_INLINE void Gpio_Clr(VPORT_t *Port, uint8_t Bit)
+{
+	Port->OUT &= ~Bit;
+}
+
+// writing a one to VPORTx.IN toggles the output
+GPIO_INLINE void Gpio_Tgl(VPORT_t *Port, uint8_t Bit)
+{
+	Port->IN = Bit;
+}
+
+// OUT is the cached pin state, SBI/CBI leave it alone when it already matches
+GPIO_INLINE void Gpio_Write(VPORT_t *Port, uint8_t Bit, uint8_t Value)
+{
+	if (Value)
+	{
+		Port->OUT |= Bit;
+	}
+	else
+	{
+		Port->OUT &= ~Bit;
+	}
+}
+
+GPIO_INLINE uint8_t Gpio_Read(VPORT_t *Port, uint8_t Bit)
+{
+	return (Port->IN & Bit) ? 1 : 0;
+}
+
+GPIO_INLINE void Gpio_Output(VPORT_t *Port, uint8_t Bit)
+{
+	Port->DIR |= Bit;
+}
+
+GPIO_INLINE void Gpio_Input(VPORT_t *Port, uint8_t Bit)
+{
+	Port->DIR &= ~Bit;
+}
+
+#endif /* GPIO_H */
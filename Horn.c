@@ -9,8 +9,12 @@
 ******************************************************************************************/
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "Horn.h"
 #include "Timer.h"
+#include "ADC.h"
+#include "Gpio.h"
+#include "Diag.h"
 
 #define KEY_FREQ 1800
 #define FREQ_ALTERNATE 1810
@@ -18,227 +22,1218 @@
 // #define KEY_FREQ 1900
 // #define FREQ_ALTERNATE 1910
 
+// Split mode plays whole counts of F_CPU / 64, the dual tone pair sits on 69 and 70, Horn.h
+#define DUAL_KEY_FREQ 1812			// 69 counts, 1811.6Hz
+#define DUAL_FREQ_ALTERNATE 1786	// 70 counts, 1785.7Hz
+
 // Create a table of PWM settings
-PWMSetting pwm_bell[] =
+#if HORN_DUAL_TONE
+// Both tones at once, each with its own envelope, DUAL_FREQ_ALTERNATE decays faster so the
+// ring settles on DUAL_KEY_FREQ and the 25.9Hz beat fades out with it
+const PWMSetting pwm_bell[] =
+{
+	// Strike
+	{  1, DUAL_KEY_FREQ,  10, DUAL_FREQ_ALTERNATE,  10 },
+	{  5, DUAL_KEY_FREQ,  40, DUAL_FREQ_ALTERNATE,  40 },
+	{  5, DUAL_KEY_FREQ,  80, DUAL_FREQ_ALTERNATE,  80 },
+	{  5, DUAL_KEY_FREQ, 100, DUAL_FREQ_ALTERNATE, 100 },
+	{ 40, DUAL_KEY_FREQ, 200, DUAL_FREQ_ALTERNATE, 200 },
+	{ 20, DUAL_KEY_FREQ, 300, DUAL_FREQ_ALTERNATE, 300 },
+	{ 10, DUAL_KEY_FREQ, 400, DUAL_FREQ_ALTERNATE, 400 },
+	// Ring, DUAL_KEY_FREQ 0.95 and DUAL_FREQ_ALTERNATE 0.88 per step
+	{120, DUAL_KEY_FREQ, 500, DUAL_FREQ_ALTERNATE, 500 },
+	{120, DUAL_KEY_FREQ, 475, DUAL_FREQ_ALTERNATE, 440 },
+	{120, DUAL_KEY_FREQ, 451, DUAL_FREQ_ALTERNATE, 387 },
+	{120, DUAL_KEY_FREQ, 429, DUAL_FREQ_ALTERNATE, 341 },
+	{120, DUAL_KEY_FREQ, 407, DUAL_FREQ_ALTERNATE, 300 },
+	{120, DUAL_KEY_FREQ, 387, DUAL_FREQ_ALTERNATE, 264 },
+	{120, DUAL_KEY_FREQ, 368, DUAL_FREQ_ALTERNATE, 232 },
+	{120, DUAL_KEY_FREQ, 349, DUAL_FREQ_ALTERNATE, 204 },
+	{120, DUAL_KEY_FREQ, 332, DUAL_FREQ_ALTERNATE, 180 },
+	{120, DUAL_KEY_FREQ, 315, DUAL_FREQ_ALTERNATE, 158 },
+	{120, DUAL_KEY_FREQ, 299, DUAL_FREQ_ALTERNATE, 139 },
+	{120, DUAL_KEY_FREQ, 284, DUAL_FREQ_ALTERNATE, 123 },
+	{120, DUAL_KEY_FREQ, 270, DUAL_FREQ_ALTERNATE, 108 },
+	{120, DUAL_KEY_FREQ, 257, DUAL_FREQ_ALTERNATE,  95 },
+	{120, DUAL_KEY_FREQ, 244, DUAL_FREQ_ALTERNATE,  84 },
+	{120, DUAL_KEY_FREQ, 232, DUAL_FREQ_ALTERNATE,  73 },
+	// End of sequence
+	{  0, 2500,         10 },
+};
+#else
+const PWMSetting pwm_bell[] =
 {
 	// First part (unchanged)
-	{  1, KEY_FREQ,       1  },
-	{  5, FREQ_ALTERNATE, 2  },
-	{  5, KEY_FREQ,       4  },
-	{  5, FREQ_ALTERNATE, 6  },
-	{  5, KEY_FREQ,       8  },
-	{  5, FREQ_ALTERNATE, 9  },
-	{  5, KEY_FREQ,      10  },
-	{ 40, FREQ_ALTERNATE,20  },
-	{ 20, KEY_FREQ,      30  },
-	{ 10, FREQ_ALTERNATE,40  },
-	{  5, KEY_FREQ,      50  },
-	// Second part (exponential decay)
-	{ 60, FREQ_ALTERNATE, 55 },
-	{180, KEY_FREQ,       50 },
-	{ 60, FREQ_ALTERNATE, 45 },
-	{180, KEY_FREQ,       40 },
-	{ 60, FREQ_ALTERNATE, 36 },
-	{180, KEY_FREQ,       32 },
-	{ 60, FREQ_ALTERNATE, 29 },
-	{180, KEY_FREQ,       26 },
-	{ 60, FREQ_ALTERNATE, 23 },
-	{180, KEY_FREQ,       21 },
-	{ 60, FREQ_ALTERNATE, 18 },
-	{180, KEY_FREQ,       16 },
-	{ 60, FREQ_ALTERNATE, 14 },
-	{180, KEY_FREQ,       13 },
-	{ 60, FREQ_ALTERNATE, 11 },
-	{180, KEY_FREQ,       10 },
-	{ 60, FREQ_ALTERNATE,  9 },
-	{180, KEY_FREQ,        8 },
+	{  1, KEY_FREQ,       10  },
+	{  5, FREQ_ALTERNATE, 20  },
+	{  5, KEY_FREQ,       40  },
+	{  5, FREQ_ALTERNATE, 60  },
+	{  5, KEY_FREQ,       80  },
+	{  5, FREQ_ALTERNATE, 90  },
+	{  5, KEY_FREQ,      100  },
+	{ 40, FREQ_ALTERNATE,200  },
+	{ 20, KEY_FREQ,      300  },
+	{ 10, FREQ_ALTERNATE,400  },
+	{  5, KEY_FREQ,      500  },
+	// Second part (exponential decay, 0.9 per step now the duty is in 0.1% steps)
+	{ 60, FREQ_ALTERNATE, 550 },
+	{180, KEY_FREQ,       495 },
+	{ 60, FREQ_ALTERNATE, 446 },
+	{180, KEY_FREQ,       401 },
+	{ 60, FREQ_ALTERNATE, 361 },
+	{180, KEY_FREQ,       325 },
+	{ 60, FREQ_ALTERNATE, 292 },
+	{180, KEY_FREQ,       263 },
+	{ 60, FREQ_ALTERNATE, 237 },
+	{180, KEY_FREQ,       213 },
+	{ 60, FREQ_ALTERNATE, 192 },
+	{180, KEY_FREQ,       173 },
+	{ 60, FREQ_ALTERNATE, 155 },
+	{180, KEY_FREQ,       140 },
+	{ 60, FREQ_ALTERNATE, 126 },
+	{180, KEY_FREQ,       113 },
+	{ 60, FREQ_ALTERNATE, 102 },
+	{180, KEY_FREQ,        92 },
 	// End of sequence
-	{  0, 2500,         1 },
+	{  0, 2500,         10 },
 };
+#endif
 
-PWMSetting pwm_charging[] =
+const PWMSetting pwm_charging[] =
 {
 	// First part (unchanged)
-	{  1, 1318 * 2, 10},
-	{  255, 1318 * 2, 40},
-	{  255, 1480 * 2, 40  },
+	{  1, 1318 * 2, 100},
+	{  255, 1318 * 2, 400},
+	{  255, 1480 * 2, 400  },
 	// End of sequence
-	{  0, 1480,         1 },
+	{  0, 1480,         10 },
 	
 };
 
-PWMSetting pwm_lowvolt[] =
+const PWMSetting pwm_lowvolt[] =
 {
 	// First part (unchanged)
-    {160, 1300,       50},
-    {160, 1300,       50},
-    {160, 1250,       40},
-    {160, 1250,       40},
-    {60, 1200,       30},
-    {60, 1150,       20},
-    {60, 1145,       10},
+    {160, 1300,       500},
+    {160, 1300,       500},
+    {160, 1250,       400},
+    {160, 1250,       400},
+    {60, 1200,       300},
+    {60, 1150,       200},
+    {60, 1145,       100},
 	// End of sequence
-	{  0, 1145,         1 },
+	{  0, 1145,         10 },
+};
+
+//Sound arbiter, one player per priority, the highest active one owns TCA0
+SoundPlayer SoundPlayers[SOUND_PRIO_COUNT];
+uint8_t SoundOwner = SOUND_OWNER_NONE;
+uint16_t SoundOldTick;
+
+//What each sound plays, at what priority, and whether it picks up again after being preempted
+const SoundBinding SoundBindings[] =
+{
+	[HORN_OFF]		= { SOUND_OWNER_NONE,		0, 0 },
+	[HORN_ON]		= { SOUND_PRIO_HORN,		0, 0 },
+	[BELL]			= { SOUND_PRIO_BELL,		0, pwm_bell },
+	[BELL_LOWVOLT]	= { SOUND_PRIO_LOWBATT,		1, pwm_lowvolt },
+	[BELL_CHARGING]	= { SOUND_PRIO_CHARGING,	0, pwm_charging },
 };
 
-uint16_t Horn_Timer;
-uint8_t Horn_Index;
-uint16_t Horn_OldTick;
+//HORN_ON drive profile variables
+HornDriveProfile HornProfile = { HORN_SOFT_START_MS, HORN_HOLD_MS, HORN_SUSTAIN_DUTY };
+uint8_t HornMode = HORN_MODE_UNKNOWN;	// pin state unknown until the first Horn_Enable()
+HornDrivePhase HornPhase;
+uint16_t HornDriveTimer_mS;
+uint16_t HornDriveOldTick;
+uint16_t HornOnTick;			// RTC tick HORN_ON started on
+
+//Battery compensation variables
+uint16_t HornTop;				// PER value last requested
+uint16_t HornDuty;				// duty last requested before compensation, 0.1% steps
+uint32_t HornBattFiltered;		// pack reading << HORN_COMP_FILTER_SHIFT, 17 bits for a 12 bit reading
+uint16_t HornCompQ8 = 256;		// duty scale, 256 = 1.0
+uint8_t HornBattCount;			// last pack reading used
+
+//Drive budget variables
+uint16_t HornDutyApplied;		// duty on the pin after compensation and budget, 0.1% steps
+uint32_t HornHeat;				// decaying integral of the weighted duty, 0.1% x mS
+uint32_t HornEnergy;			// this honk's integral of the weighted duty, 0.1% x mS
+uint16_t HornBudgetQ8 = 256;	// HORN_ON duty scale, 256 = 1.0
+
+//Tone synthesis variables
+uint8_t HornClkSel;				// TCA0 prescaler in use
+volatile uint16_t HornDitherTop;	// PER for a short period, a long one is one more
+volatile uint8_t HornDitherFrac;	// share of long periods in 1/256ths
+uint8_t HornDitherAcc;
+uint8_t HornSplit;				// TCA0 in split mode for a dual tone step
+uint8_t HornTop2;				// high half PER
+uint16_t HornDuty2;				// high half duty before compensation, 0.1% steps
+uint8_t HornBridgeLegs;			// HORN_LEGS_ONE or HORN_LEGS_BOTH
+uint8_t HornDeadCnt;			// bridge dead time in counts at the prescaler in use
+
+//TCA0 prescalers smallest first, with their divide ratio as a shift
+const uint8_t HornClkSels[] = { TCA_SINGLE_CLKSEL_DIV1_gc, TCA_SINGLE_CLKSEL_DIV2_gc, TCA_SINGLE_CLKSEL_DIV4_gc,
+	TCA_SINGLE_CLKSEL_DIV8_gc, TCA_SINGLE_CLKSEL_DIV16_gc, TCA_SINGLE_CLKSEL_DIV64_gc,
+	TCA_SINGLE_CLKSEL_DIV256_gc, TCA_SINGLE_CLKSEL_DIV1024_gc };
+const uint8_t HornClkShifts[] = { 0, 1, 2, 3, 4, 6, 8, 10 };
+
+//local Functions
+static void Horn_SetPWM(uint16_t top_value, uint16_t duty_cycle);
+static void Horn_SetTone(uint16_t frequency, uint16_t duty_cycle);
+static uint8_t Horn_SplitMode(uint8_t On);
+static void Horn_BridgeLegs(uint8_t Legs);
+static void Horn_SetDualTone(uint16_t Freq0, uint16_t Duty0, uint16_t Freq1, uint16_t Duty1);
+static void Horn_LoadPWM(void);
+static void Horn_Compensate(uint16_t Battery);
+static uint16_t Horn_DriveDuty(void);
+static uint16_t Horn_FadeQ8(uint32_t Level, uint32_t Start, uint8_t Shift);
+static void Horn_Budget(uint16_t Ticks);
+static void Sound_Arbitrate(void);
+static void Horn_CclGate(uint8_t Bell);
+static void Sound_LoadStep(SoundPlayer *Player);
+static uint8_t Sound_Step(void);
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_SetPWM()
+//* Object              : request a TCA0 period and duty, the duty is battery compensated
+//* Input Parameters    : uint16_t top_value = PER value, uint16_t duty_cycle = 0-HORN_DUTY_FULL
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Horn_SetPWM(uint16_t top_value, uint16_t duty_cycle)
+{
+	HornTop = top_value;
+	HornDuty = duty_cycle;
+
+	Horn_LoadPWM();
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_SetTone()
+//* Object              : pick the smallest TCA0 prescaler the period fits in, split the
+//*                       period into whole counts and a dithered fraction, and load it
+//* Input Parameters    : uint16_t frequency = Hz, uint16_t duty_cycle = 0-HORN_DUTY_FULL
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Horn_SetTone(uint16_t frequency, uint16_t duty_cycle)
+{
+	uint8_t Sel = 0;
+	uint32_t Divisor = (uint32_t)frequency << HORN_PERIOD_SHIFT;
+
+	// smallest prescaler with the whole period inside 16 bits
+	while ((HORN_CPU_CLOCK / Divisor) > HORN_COUNTS_MAX && Sel < sizeof(HornClkShifts) - 1)
+	{
+		Sel++;
+		Divisor = (uint32_t)frequency << (HornClkShifts[Sel] + HORN_PERIOD_SHIFT);
+	}
+
+	uint32_t Counts = HORN_CPU_CLOCK / Divisor;
+	if (Counts > HORN_COUNTS_MAX)
+	Counts = HORN_COUNTS_MAX;
+
+#if HORN_BRIDGE
+	HornDeadCnt = HORN_BRIDGE_DEAD_CNT >> HornClkShifts[Sel];
+	if (HornDeadCnt == 0)
+	HornDeadCnt = 1;
+#endif
+
+	// Divisor is under 2^24 here so the remainder can be scaled to 1/256ths in 32 bits
+	uint8_t Frac = ((HORN_CPU_CLOCK % Divisor) << 8) / Divisor;
+
+	// back from a dual tone step, TCA0 was reset so PER is loaded directly, not through PERBUF
+	if (Horn_SplitMode(0))
+	{
+		TCA0.SINGLE.PER = HORN_TOP(Counts);
+	}
+
+	// keep the overflow interrupt off while its variables change
+	TCA0.SINGLE.INTCTRL = 0;
+
+	if (HornClkSels[Sel] != HornClkSel)
+	{
+		HornClkSel = HornClkSels[Sel];
+		TCA0.SINGLE.CTRLA = HornClkSel | TCA_SINGLE_ENABLE_bm;
+	}
+
+	HornDitherTop = HORN_TOP(Counts);
+	HornDitherFrac = Frac;
+
+	Horn_SetPWM(HORN_TOP(Counts), duty_cycle);
+
+#if HORN_PER_DITHER
+	if (Frac)
+	{
+		TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+		TCA0.SINGLE.INTCTRL = TCA_SINGLE_OVF_bm;
+	}
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_SplitMode()
+//* Object              : move TCA0 between single (16 bit) and split (two 8 bit) mode, it has
+//*                       to be stopped and reset to change.  Left stopped, the caller loads
+//*                       the new tone and starts it.  HORN_DUAL_TONE only
+//* Input Parameters    : uint8_t On = 1 for split mode
+//* Output Parameters   : uint8_t = 1 if the mode changed
+//*--------------------------------------------------------------------------------------
+
+static uint8_t Horn_SplitMode(uint8_t On)
+{
+#if HORN_DUAL_TONE
+	if (HornSplit == On)
+	{
+		return 0;
+	}
+
+	TCA0.SINGLE.CTRLA = 0;
+	TCA0.SINGLE.INTCTRL = 0;
+	TCA0.SINGLE.CTRLESET = TCA_SINGLE_CMD_RESET_gc;
+
+	if (On)
+	{
+		PORTMUX.CTRLC |= HORN2_PORTMUX;
+		TCA0.SPLIT.CTRLD = TCA_SPLIT_SPLITM_bm;
+		TCA0.SPLIT.CTRLB = TCA_SPLIT_LCMP0EN_bm | TCA_SPLIT_HCMP0EN_bm;
+	}
+	else
+	{
+		TCA0.SINGLE.CTRLD = 0;
+		TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_SINGLESLOPE_gc | TCA_SINGLE_CMP0EN_bm;
+	}
+
+	HornClkSel = HORN_CLKSEL_NONE;
+	HornSplit = On;
+	return 1;
+#else
+	(void)On;
+	return 0;
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_BridgeLegs()
+//* Object              : hand leg B to TCA0 WO2 or hold it off, HORN_BRIDGE only.  Leg B's
+//*                       pin is inverted, so off is port OUT set.  Call with PER loaded,
+//*                       WO2 starts with CMP2 = PER so leg B stays off until Horn_LoadPWM()
+//*                       gives it a duty; CMP2 at 0 would hold it on, DC across the transducer
+//* Input Parameters    : uint8_t Legs = HORN_LEGS_ONE or HORN_LEGS_BOTH
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Horn_BridgeLegs(uint8_t Legs)
+{
+#if HORN_BRIDGE
+	HORN_B_CTRL = PORT_INVEN_bm;
+	GPIO_SET(HORN_B);
+	GPIO_OUTPUT(HORN_B);
+
+	if (Legs == HORN_LEGS_BOTH)
+	{
+		TCA0.SINGLE.CMP2 = TCA0.SINGLE.PER;
+		TCA0.SINGLE.CMP2BUF = TCA0.SINGLE.PER;
+		TCA0.SINGLE.CTRLB |= TCA_SINGLE_CMP2EN_bm;
+	}
+	else
+	{
+		TCA0.SINGLE.CTRLB &= ~TCA_SINGLE_CMP2EN_bm;
+	}
+
+	HornBridgeLegs = Legs;
+#else
+	(void)Legs;
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_SetDualTone()
+//* Object              : play two tones at once from TCA0 split mode, one prescaler for both
+//*                       halves, the smallest the lower tone fits 8 bits with.  HORN_DUAL_TONE
+//*                       only, called for steps with a frequency2
+//* Input Parameters    : uint16_t Freq0, Duty0 = low half, horn pin
+//*                       uint16_t Freq1, Duty1 = high half, HORN2 pin
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Horn_SetDualTone(uint16_t Freq0, uint16_t Duty0, uint16_t Freq1, uint16_t Duty1)
+{
+#if HORN_DUAL_TONE
+	uint16_t Low = (Freq0 < Freq1) ? Freq0 : Freq1;
+	uint8_t Sel = 0;
+
+	while (((HORN_CPU_CLOCK >> HornClkShifts[Sel]) / Low) > 256UL && Sel < sizeof(HornClkShifts) - 1)
+	{
+		Sel++;
+	}
+
+	uint32_t Clock = HORN_CPU_CLOCK >> HornClkShifts[Sel];
+	uint32_t Counts0 = (Clock + Freq0 / 2) / Freq0;
+	uint32_t Counts1 = (Clock + Freq1 / 2) / Freq1;
+
+	if (Counts0 > 256UL)
+	Counts0 = 256UL;
+	if (Counts1 > 256UL)
+	Counts1 = 256UL;
+
+	// split mode has no buffered registers, the step changes on the next count
+	Horn_SplitMode(1);
+
+	HornTop = Counts0 - 1;
+	HornTop2 = Counts1 - 1;
+	HornDuty = Duty0;
+	HornDuty2 = Duty1;
+
+	TCA0.SPLIT.LPER = HornTop;
+	TCA0.SPLIT.HPER = HornTop2;
+	Horn_LoadPWM();
+
+	if (HornClkSels[Sel] != HornClkSel)
+	{
+		HornClkSel = HornClkSels[Sel];
+		TCA0.SPLIT.CTRLA = HornClkSel | TCA_SPLIT_ENABLE_bm;
+	}
+#else
+	(void)Freq0;
+	(void)Duty0;
+	(void)Freq1;
+	(void)Duty1;
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : TCA0_OVF_vect
+//* Object              : period dithering, first order sigma delta on the fraction
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+ISR(TCA0_OVF_vect)
+{
+	DIAG_ISR_ENTER();
+
+	TCA0.SINGLE.INTFLAGS = TCA_SINGLE_OVF_bm;
+
+	uint8_t Acc = HornDitherAcc + HornDitherFrac;
+
+	// carry out of the accumulator -> this period is one count longer
+	TCA0.SINGLE.PERBUF = (Acc < HornDitherAcc) ? HornDitherTop + 1 : HornDitherTop;
+	HornDitherAcc = Acc;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_LoadPWM()
+//* Object              : load the double-buffered TCA0 period and compensated duty.  While
+//*                       the period is dithered TCA0_OVF_vect owns PERBUF, Horn_SetTone()
+//*                       loads the base period with the interrupt off and only CMPnBUF
+//*                       change after that
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Horn_LoadPWM(void)
+{
+#if HORN_DUAL_TONE
+	if (HornSplit)
+	{
+		uint32_t Duty0 = ((uint32_t)HornDuty * HornCompQ8) >> 8;
+		uint32_t Duty1 = ((uint32_t)HornDuty2 * HornCompQ8) >> 8;
+
+		if (Duty0 > HORN_DUTY_FULL)
+		Duty0 = HORN_DUTY_FULL;
+		if (Duty1 > HORN_DUTY_FULL)
+		Duty1 = HORN_DUTY_FULL;
+
+		// both gates load the pack, the budget sees their sum
+		HornDutyApplied = (Duty0 + Duty1 > HORN_DUTY_FULL) ? HORN_DUTY_FULL : Duty0 + Duty1;
+
+		// split mode sets WOn at CMP and clears it at BOTTOM, high for CMP of PER + 1 counts
+		uint16_t Cmp0 = ((uint32_t)(HornTop + 1) * Duty0) / HORN_DUTY_FULL;
+		uint16_t Cmp1 = ((uint32_t)(HornTop2 + 1) * Duty1) / HORN_DUTY_FULL;
+
+		TCA0.SPLIT.LCMP0 = (Cmp0 > HornTop) ? HornTop : Cmp0;
+		TCA0.SPLIT.HCMP0 = (Cmp1 > HornTop2) ? HornTop2 : Cmp1;
+		return;
+	}
+#endif
+
+	uint16_t top_value = HornTop;
+
+	// Scale for battery voltage and limit duty cycle to 100%
+	uint32_t duty_cycle = ((uint32_t)HornDuty * HornCompQ8) >> 8;
+	if (duty_cycle > HORN_DUTY_FULL)
+	duty_cycle = HORN_DUTY_FULL;
+
+	// HORN_ON fades as the drive budget runs out
+	if (HornMode == HORN_ON)
+	duty_cycle = (duty_cycle * HornBudgetQ8) >> 8;
+
+	HornDutyApplied = duty_cycle;
+
+#if HORN_BRIDGE
+	// dual slope, a leg is on for CMP counts either side of BOTTOM (leg A) or TOP (leg B), at
+	// 100% on one leg alone that is one count short of the whole period
+	uint16_t cmp_value;
+
+	if (HornBridgeLegs == HORN_LEGS_BOTH)
+	{
+		uint16_t Half = (top_value > HornDeadCnt) ? (top_value - HornDeadCnt) / 2 : 0;
+
+		cmp_value = ((uint32_t)Half * duty_cycle) / HORN_DUTY_FULL;
+		TCA0.SINGLE.CMP2BUF = top_value - cmp_value;
+	}
+	else
+	{
+		cmp_value = ((uint32_t)top_value * duty_cycle) / HORN_DUTY_FULL;
+	}
+
+	if (!(TCA0.SINGLE.INTCTRL & TCA_SINGLE_OVF_bm))
+	TCA0.SINGLE.PERBUF = top_value;
+	TCA0.SINGLE.CMP0BUF = cmp_value;
+#else
+	// Calculate the compare value, 32 bit so large top values do not overflow
+	uint16_t cmp_value = ((uint32_t)top_value * duty_cycle) / HORN_DUTY_FULL;
+
+	// Handle special case for 100% duty cycle, compare never matches so the output stays high
+	if (duty_cycle == HORN_DUTY_FULL && top_value < 0xFFFF)
+	cmp_value = top_value + 1;
+
+	if (!(TCA0.SINGLE.INTCTRL & TCA_SINGLE_OVF_bm))
+	TCA0.SINGLE.PERBUF = top_value;
+	TCA0.SINGLE.CMP0BUF = cmp_value;
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_Compensate()
+//* Object              : filter a pack reading and work out the duty scale for constant power
+//* Input Parameters    : uint16_t Battery = 12 bit pack reading from ADC1
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Horn_Compensate(uint16_t Battery)
+{
+	if (HornBattFiltered == 0)
+	{
+		HornBattFiltered = (uint32_t)Battery << HORN_COMP_FILTER_SHIFT;
+	}
+	else
+	{
+		HornBattFiltered += Battery - (HornBattFiltered >> HORN_COMP_FILTER_SHIFT);
+	}
+
+	uint32_t Volts = HornBattFiltered >> HORN_COMP_FILTER_SHIFT;
+	uint32_t Scale = HORN_COMP_MAX_Q8;
+
+	// (nominal / Vbat)^2 in Q8
+	if (Volts)
+	{
+		Scale = ((uint32_t)HORN_COMP_NOMINAL_CNT * HORN_COMP_NOMINAL_CNT * 256) / (Volts * Volts);
+	}
+
+	HornCompQ8 = (Scale > HORN_COMP_MAX_Q8) ? HORN_COMP_MAX_Q8 : Scale;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_FadeQ8()
+//* Object              : duty scale for one budget integral, linear fade past Start
+//* Input Parameters    : uint32_t Level = integral, uint32_t Start = where the fade starts,
+//*                       uint8_t Shift = fade length as a power of 2
+//* Output Parameters   : uint16_t = scale, 256 = 1.0, 0 once below HORN_BUDGET_MIN_Q8
+//*--------------------------------------------------------------------------------------
+
+static uint16_t Horn_FadeQ8(uint32_t Level, uint32_t Start, uint8_t Shift)
+{
+	if (Level <= Start)
+	{
+		return 256;
+	}
+
+	Level -= Start;
+
+	if (Level >> Shift)
+	{
+		return 0;
+	}
+
+	uint16_t Scale = 256 - (uint16_t)(Level >> (Shift - 8));
+
+	return (Scale < HORN_BUDGET_MIN_Q8) ? 0 : Scale;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_Budget()
+//* Object              : for the mS passed, decay the heat, add the drive to the heat and
+//*                       energy integrals and work out the HORN_ON duty scale
+//* Input Parameters    : uint16_t Ticks = mS since the last call
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Horn_Budget(uint16_t Ticks)
+{
+	uint16_t Load = 0;
+
+	if (Horn_IsDriving())
+	{
+		Load = ((uint32_t)HornDutyApplied * HornCompQ8) >> 8;
+	}
+
+	// n mS of decay as n x one mS's, close to (1 - 1/2^TAU)^n while n is short against the
+	// time constant, so a long gap (the charging loop does not run this) goes in steps
+	while (Ticks)
+	{
+		uint16_t Step = (Ticks > HORN_HEAT_STEP_MAX) ? HORN_HEAT_STEP_MAX : Ticks;
+
+		HornHeat -= (HornHeat >> HORN_HEAT_TAU_SHIFT) * Step;
+		HornHeat += (uint32_t)Load * Step;
+		HornEnergy += (uint32_t)Load * Step;
+		Ticks -= Step;
+	}
+
+	uint16_t Heat = Horn_FadeQ8(HornHeat, HORN_HEAT_FADE_START, HORN_HEAT_FADE_SHIFT);
+	uint16_t Energy = Horn_FadeQ8(HornEnergy, HORN_ENERGY_FADE_START, HORN_ENERGY_FADE_SHIFT);
+
+	HornBudgetQ8 = (Heat < Energy) ? Heat : Energy;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_BudgetSpent()
+//* Object              : has the drive budget ended this honk
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = 1 when HORN_ON has faded out
+//*--------------------------------------------------------------------------------------
+
+uint8_t Horn_BudgetSpent(void)
+{
+	return (HornMode == HORN_ON && HornBudgetQ8 == 0);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_BudgetRead()
+//* Object              : drive budget telemetry, read through Diag_Read()
+//* Input Parameters    : uint8_t Which = HornBudgetItem
+//* Output Parameters   : uint16_t = value
+//*--------------------------------------------------------------------------------------
+
+uint16_t Horn_BudgetRead(uint8_t Which)
+{
+	switch (Which)
+	{
+		case HORN_BUDGET_HEAT:
+		{
+			return HornHeat >> 10;
+		}
+
+		case HORN_BUDGET_ENERGY:
+		{
+			return HornEnergy >> 10;
+		}
+
+		default:
+		{
+			return HornBudgetQ8;
+		}
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_CclInit()
+//* Object              : set up the CCL bypass LUTs, HORN_CCL_BYPASS only.  The CCL stays
+//*                       off until the horn drives
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Horn_CclInit(void)
+{
+#if HORN_CCL_BYPASS
+	CCL.CTRLA = 0;
+
+	// horn switch pin level to LUT1 event input 0
+	EVSYS.ASYNCCH1 = HORN_CCL_SWITCH_GEN;
+	EVSYS.ASYNCUSER3 = EVSYS_ASYNCUSER3_ASYNCCH1_gc;	// CCL LUT1EV0
+
+	CCL.LUT1CTRLB = CCL_INSEL0_TCA0_gc | CCL_INSEL1_EVENT0_gc;
+	CCL.LUT1CTRLC = CCL_INSEL2_TCA0_gc;
+	CCL.TRUTH1 = HORN_CCL_TRUTH1;
+	CCL.LUT1CTRLA = CCL_ENABLE_bm;
+
+	// the filter drops comparator glitches shorter than a few clocks
+	CCL.LUT0CTRLB = CCL_INSEL0_LINK_gc | CCL_INSEL1_AC0_gc;
+	CCL.LUT0CTRLC = CCL_INSEL2_MASK_gc;
+	CCL.TRUTH0 = HORN_CCL_TRUTH0;
+	CCL.LUT0CTRLA = CCL_FILTSEL_FILTER_gc | CCL_OUTEN_bm | CCL_ENABLE_bm;
+
+	GPIO_CLR(HORN);
+	GPIO_OUTPUT(HORN);
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_CclGate()
+//* Object              : firmware side of the CCL bypass, enable the LUTs and set the WO2
+//*                       gate bit, HORN_CCL_BYPASS only
+//* Input Parameters    : uint8_t Bell = 1 to play without the switch, 0 to follow it
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Horn_CclGate(uint8_t Bell)
+{
+#if HORN_CCL_BYPASS
+	// WO2 is a constant level, never high with CMP2 = 0, never low with CMP2 past TOP
+	TCA0.SINGLE.CMP2 = Bell ? 0xFFFF : 0;
+	CCL.CTRLA = CCL_ENABLE_bm;
+#else
+	(void)Bell;
+#endif
+}
 
 
 //*--------------------------------------------------------------------------------------
 //* Function Name       : Bell_Init()
-//* Object              : setup I/O pins used by horn
+//* Object              : setup TCA0 and the horn pin for the bell tone output
 //* Input Parameters    : none
 //* Output Parameters   : none
 //*--------------------------------------------------------------------------------------
 
 void Bell_Init(void)
 {
-	// Configure TCA0 for single-slope PWM
-	TCA0.SINGLE.CTRLB = TCA_SINGLE_WGMODE_SINGLESLOPE_gc | TCA_SINGLE_CMP0EN_bm;
+	Horn_SplitMode(0);
+
+	// Configure TCA0 for single-slope PWM, dual slope through the bridge
+	TCA0.SINGLE.CTRLB = HORN_WGMODE | TCA_SINGLE_CMP0EN_bm;
 
-	// Set TOP value for 1 kHz PWM
-	TCA0.SINGLE.PER = (F_CPU / 64 / 1000) - 1; // Assuming F_CPU = 20 MHz and prescaler of 64
+	// Set TOP value for 1 kHz PWM, Horn_SetTone() picks the prescaler per step from here
+	TCA0.SINGLE.PER = HORN_TOP((HORN_CPU_CLOCK / 1000) >> HORN_PERIOD_SHIFT);
+	HornDeadCnt = HORN_BRIDGE_DEAD_CNT;
 
-	// Set duty cycle
+	// Set duty cycle, leg B off with it
 	TCA0.SINGLE.CMP0 = 0;
+	TCA0.SINGLE.INTCTRL = 0;
+	Horn_BridgeLegs(HORN_LEGS_BOTH);
 
 	// Set the prescaler and enable TCA0
-	TCA0.SINGLE.CTRLA = TCA_SINGLE_CLKSEL_DIV64_gc | TCA_SINGLE_ENABLE_bm;
+	HornClkSel = TCA_SINGLE_CLKSEL_DIV1_gc;
+	TCA0.SINGLE.CTRLA = HornClkSel | TCA_SINGLE_ENABLE_bm;
 	
 	// Set HORN as an output
-	HORN_PORT.DIRSET = HORN_BIT;
+	GPIO_OUTPUT(HORN);
+#if HORN_DUAL_TONE
+	GPIO_CLR(HORN2);
+	GPIO_OUTPUT(HORN2);
+#endif
 
-	// really this is a bell timer
-	Horn_Timer = 0;
-	Horn_Index = 0;
+	HornTop = TCA0.SINGLE.PER;
+	HornDuty = 0;
+	HornMode = BELL;
 
-	Horn_Timer = pwm_bell[Horn_Index].TimeNextStep;
+	Horn_CclGate(1);
 }
 
 
 //*--------------------------------------------------------------------------------------
-//* Function Name       : Bell_Update()
-//* Object              : this really is what controlls the bell!
-//* Input Parameters    : none
-//* Output Parameters   : uint8_t = 1 if Bell still running
+//* Function Name       : Horn_Enable()
+//* Object              : Horn enable Function, setup the GPIO based on input
+//* Input Parameters    : uint8_t Enable = true to turn horn on
+//* Output Parameters   : none
 //*--------------------------------------------------------------------------------------
 
-uint8_t Bell_Update(SpeakerState speaker_state)
+void Horn_Enable(uint8_t Enable)
 {
+	if(Enable == HORN_OFF)
+	{
+		// already off, the charging loop calls this every pass
+		if(HornMode == HORN_OFF)
+		{
+			return;
+		}
+
+		// Disable PWM, from single mode so WO0 and WO3 both go back to the port
+		Horn_SplitMode(0);
+		TCA0.SINGLE.CTRLA = 0;
+		TCA0.SINGLE.CTRLB &= ~TCA_SINGLE_CMP0EN_bm;
+		Horn_BridgeLegs(HORN_LEGS_ONE);
+		TCA0.SINGLE.INTCTRL = 0;
 
-	PWMSetting *pwm_settings;
+#if HORN_CCL_BYPASS
+		CCL.CTRLA = 0;
+#endif
+		GPIO_OUTPUT(HORN);
+		GPIO_CLR(HORN);
 
-	switch (speaker_state){
-		case BELL:
+		HornMode = HORN_OFF;
+	}
+
+	else if(Enable == HORN_ON)
+	{
+		// already honking, let Horn_Update() carry on with the profile
+		if(HornMode == HORN_ON)
 		{
-			pwm_settings = pwm_bell;
-			break;
+			return;
 		}
-		case BELL_CHARGING:
-		{
-			pwm_settings = pwm_charging;
-			break;
 
+		// Start the soft start ramp on a PWM carrier instead of driving the pin straight high
+		Horn_SplitMode(0);
+		TCA0.SINGLE.CTRLA = 0;
+		TCA0.SINGLE.CTRLB = HORN_WGMODE | TCA_SINGLE_CMP0EN_bm;
+		TCA0.SINGLE.INTCTRL = 0;
+		TCA0.SINGLE.CNT = 0;
+		TCA0.SINGLE.PER = HORN_TOP((HORN_CPU_CLOCK / HORN_DRIVE_FREQ) >> HORN_PERIOD_SHIFT);
+		TCA0.SINGLE.CMP0 = 0;
+		Horn_BridgeLegs(HORN_BRIDGE_HORN_ON ? HORN_LEGS_BOTH : HORN_LEGS_ONE);
+		HornDeadCnt = HORN_BRIDGE_DEAD_CNT;
+
+		GPIO_CLR(HORN);
+		GPIO_OUTPUT(HORN);
+
+		HornPhase = HORN_DRIVE_RAMP;
+		HornDriveTimer_mS = 0;
+		HornEnergy = 0;
+		HornBudgetQ8 = Horn_FadeQ8(HornHeat, HORN_HEAT_FADE_START, HORN_HEAT_FADE_SHIFT);
+		HornDriveOldTick = RTC_getTick();
+		HornOnTick = HornDriveOldTick;
+		HornMode = HORN_ON;
+
+		Horn_SetPWM(HORN_TOP((HORN_CPU_CLOCK / HORN_DRIVE_FREQ) >> HORN_PERIOD_SHIFT), Horn_DriveDuty());
+		HornClkSel = TCA_SINGLE_CLKSEL_DIV1_gc;
+		TCA0.SINGLE.CTRLA = HornClkSel | TCA_SINGLE_ENABLE_bm;
+
+		Horn_CclGate(0);
+	}
+
+	else if(Enable == BELL || Enable == BELL_LOWVOLT || Enable == BELL_CHARGING)
+	{
+		Bell_Init();
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_DriveDuty()
+//* Object              : work out the HORN_ON duty for the current phase of the profile
+//* Input Parameters    : none
+//* Output Parameters   : uint16_t = duty in 0.1% steps
+//*--------------------------------------------------------------------------------------
+
+static uint16_t Horn_DriveDuty(void)
+{
+	switch (HornPhase)
+	{
+		case HORN_DRIVE_RAMP:
+		{
+			if(HornDriveTimer_mS >= HornProfile.RampTime_mS)
+			{
+				return HORN_DUTY_FULL;
+			}
+			return (HORN_SOFT_START_DUTY * 10) + ((uint32_t)(HORN_DUTY_FULL - HORN_SOFT_START_DUTY * 10) * HornDriveTimer_mS) / HornProfile.RampTime_mS;
 		}
-		case BELL_LOWVOLT:
+
+		case HORN_DRIVE_HOLD:
 		{
-			pwm_settings = pwm_lowvolt;
-			break;
+			return HORN_DUTY_FULL;
+		}
 
+		default:
+		{
+			return HornProfile.SustainDuty * 10;
 		}
 	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_IsDriving()
+//* Object              : is TCA0 driving the horn (horn carrier or a bell sequence)
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = 1 when the horn can be drawing current
+//*--------------------------------------------------------------------------------------
+
+uint8_t Horn_IsDriving(void)
+{
+	return (HornMode != HORN_OFF && HornMode != HORN_MODE_UNKNOWN);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_IsHonking()
+//* Object              : is the HORN_ON carrier driving, as opposed to a bell sequence
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = 1 while honking
+//*--------------------------------------------------------------------------------------
+
+uint8_t Horn_IsHonking(void)
+{
+	return (HornMode == HORN_ON);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_HonkTime()
+//* Object              : how long HORN_ON has been driving
+//* Input Parameters    : none
+//* Output Parameters   : uint16_t = mS since HORN_ON started, 0xFFFF when not honking
+//*--------------------------------------------------------------------------------------
+
+uint16_t Horn_HonkTime(void)
+{
+	if(HornMode != HORN_ON)
+	{
+		return 0xFFFF;
+	}
+
+	uint16_t Elapsed = RTC_elapsedMS(HornOnTick);
+
+	return (Elapsed == 0xFFFF) ? 0xFFFE : Elapsed;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_Update()
+//* Object              : step the HORN_ON drive profile, ramp -> hold -> sustain, keep the
+//*                       drive budget, and rescale the horn or bell duty for the pack voltage
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
 
-	uint8_t Status = 0;
+void Horn_Update(void)
+{
+	uint16_t Ticks = RTC_tickUpdate(&HornDriveOldTick);
 
-	if (Horn_OldTick != RTC_getTick())
+	if(Ticks)
 	{
-		Horn_OldTick = RTC_getTick();
+		// the horn cools whether it is driving or not
+		Horn_Budget(Ticks);
 
-		if (Horn_Timer)
+		if(HornMode == HORN_OFF || HornMode == HORN_MODE_UNKNOWN)
 		{
-			Status = 1;
-			Horn_Timer--;
+			return;
 		}
-		else
+
+		if(HornMode == HORN_ON && HornPhase != HORN_DRIVE_SUSTAIN)
 		{
-			if (pwm_settings[Horn_Index].TimeNextStep != 0)
+			HornDriveTimer_mS += Ticks;
+
+			if(HornPhase == HORN_DRIVE_RAMP && HornDriveTimer_mS >= HornProfile.RampTime_mS)
 			{
-				Status = 1;
+				HornPhase = HORN_DRIVE_HOLD;
+				HornDriveTimer_mS = 0;
+			}
+			else if(HornPhase == HORN_DRIVE_HOLD && HornDriveTimer_mS >= HornProfile.HoldTime_mS)
+			{
+				HornPhase = HORN_DRIVE_SUSTAIN;
+			}
 
-				Horn_Index++; // Advance to the next cycle
+			HornDuty = Horn_DriveDuty();
+		}
 
-				// Clamp the frequency to a valid range
-				uint16_t frequency = pwm_settings[Horn_Index].frequency;
-				if (frequency < MIN_FREQ)
-				frequency = MIN_FREQ;
-				else if (frequency > MAX_FREQ)
-				frequency = MAX_FREQ;
+		// close the loop on the pack voltage while the horn or bell is driving
+		uint16_t Battery;
 
-				// Calculate the top value based on frequency
-				uint16_t top_value = (HORN_CPU_CLOCK / 64 / frequency) - 1; // Prescaler of 64
+		if(ADC_BattSenseUpdate(&HornBattCount, &Battery))
+		{
+			Horn_Compensate(Battery);
+		}
 
-				// Ensure the top value is within a valid range
-				if (top_value == 0 || top_value >= 65536)
-				top_value = 65535;
+		Horn_LoadPWM();
+	}
+}
 
-				// Set the double-buffered PER value for the desired frequency
-				TCA0.SINGLE.PERBUF = top_value;
 
-				// Limit duty cycle to 100%
-				uint8_t duty_cycle = pwm_settings[Horn_Index].duty_cycle;
-				if (duty_cycle > 100)
-				duty_cycle = 100;
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Horn_SetDriveProfile()
+//* Object              : program the HORN_ON soft start, hold and sustain settings
+//* Input Parameters    : uint16_t RampTime_mS, uint16_t HoldTime_mS, uint8_t SustainDuty = 0-100%
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
 
-				// Calculate and set the double-buffered CMP0 safely
-				uint16_t cmp_value = (top_value * duty_cycle) / 100;
+void Horn_SetDriveProfile(uint16_t RampTime_mS, uint16_t HoldTime_mS, uint8_t SustainDuty)
+{
+	HornProfile.RampTime_mS = RampTime_mS;
+	HornProfile.HoldTime_mS = HoldTime_mS;
+	HornProfile.SustainDuty = (SustainDuty > 100) ? 100 : SustainDuty;
+}
 
-				// Handle special case for 100% duty cycle
-				if (duty_cycle == 100)
-				cmp_value = top_value;
 
-				TCA0.SINGLE.CMP0BUF = (cmp_value <= top_value) ? cmp_value : top_value;
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sound_Start()
+//* Object              : ask for a sound, its player is bound to its sequence here once
+//*                       and the arbiter decides whether it plays now or waits its turn
+//* Input Parameters    : SpeakerState Sound = HORN_ON, BELL, BELL_LOWVOLT or BELL_CHARGING
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
 
-				// Set Timer
-				Horn_Timer = pwm_settings[Horn_Index].TimeNextStep;
-			}
+void Sound_Start(SpeakerState Sound)
+{
+	if(Sound > BELL_CHARGING || SoundBindings[Sound].Priority == SOUND_OWNER_NONE)
+	{
+		return;
+	}
+
+	const SoundBinding *Binding = &SoundBindings[Sound];
+
+	SoundPlayer *Player = &SoundPlayers[Binding->Priority];
+
+	// the horn is asked for every tick while the button is held, leave it running
+	if(Player->Active && Binding->Sequence == 0)
+	{
+		return;
+	}
+
+	Player->Sequence = Binding->Sequence;
+	Player->Index = 0;
+	Player->Timer = (Binding->Sequence) ? Binding->Sequence[0].TimeNextStep : 0;
+	Player->Resume = Binding->Resume;
+	Player->Active = 1;
+
+	// restarting the sound that owns the output, make the arbiter load it again
+	if(SoundOwner == Binding->Priority)
+	{
+		SoundOwner = SOUND_OWNER_NONE;
+	}
+
+	Sound_Arbitrate();
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sound_Stop()
+//* Object              : drop a sound, anything lower that was waiting gets the output
+//* Input Parameters    : SpeakerState Sound = sound to stop
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Sound_Stop(SpeakerState Sound)
+{
+	if(!Sound_IsPlaying(Sound))
+	{
+		return;
+	}
+
+	SoundPlayers[SoundBindings[Sound].Priority].Active = 0;
+	Sound_Arbitrate();
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sound_IsPlaying()
+//* Object              : check if a sound is playing or waiting to play
+//* Input Parameters    : SpeakerState Sound = sound to check
+//* Output Parameters   : uint8_t = 1 if still active
+//*--------------------------------------------------------------------------------------
+
+uint8_t Sound_IsPlaying(SpeakerState Sound)
+{
+	if(Sound > BELL_CHARGING || SoundBindings[Sound].Priority == SOUND_OWNER_NONE)
+	{
+		return 0;
+	}
+
+	return SoundPlayers[SoundBindings[Sound].Priority].Active;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sound_Current()
+//* Object              : which sound owns the horn
+//* Input Parameters    : none
+//* Output Parameters   : SpeakerState = the owner, HORN_OFF for none or while killed
+//*--------------------------------------------------------------------------------------
+
+SpeakerState Sound_Current(void)
+{
+	for(uint8_t Sound = HORN_ON; Sound <= BELL_CHARGING; Sound++)
+	{
+		if(SoundBindings[Sound].Priority == SoundOwner)
+		{
+			return Sound;
 		}
 	}
-	return Status;
+
+	return HORN_OFF;
 }
 
+
 //*--------------------------------------------------------------------------------------
-//* Function Name       : Horn_Enable()
-//* Object              : Horn enable Function, setup the GPIO based on input
-//* Input Parameters    : uint8_t Enable = true to turn horn on
+//* Function Name       : Sound_Kill()
+//* Object              : highest priority request, holds the output silent while set
+//* Input Parameters    : uint8_t Enable = 1 to silence everything, 0 to release
 //* Output Parameters   : none
 //*--------------------------------------------------------------------------------------
 
-void Horn_Enable(uint8_t Enable)
+void Sound_Kill(uint8_t Enable)
 {
-	if(Enable == HORN_OFF)
+	if(SoundPlayers[SOUND_PRIO_KILL].Active == Enable)
 	{
-		// Disable PWM
-		TCA0.SINGLE.CTRLA = 0;
-		TCA0.SINGLE.CTRLB &= ~TCA_SINGLE_CMP0EN_bm;
+		return;
+	}
+
+	SoundPlayers[SOUND_PRIO_KILL].Sequence = 0;
+	SoundPlayers[SOUND_PRIO_KILL].Resume = 1;
+	SoundPlayers[SOUND_PRIO_KILL].Active = Enable;
+	Sound_Arbitrate();
+}
 
-		HORN_PORT.DIRSET = HORN_BIT;
-		HORN_PORT.OUTCLR = HORN_BIT;
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sound_Arbitrate()
+//* Object              : hand TCA0 to the highest priority active player, a preempted
+//*                       player is dropped unless it was started as resumable
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sound_Arbitrate(void)
+{
+	uint8_t Best = SOUND_OWNER_NONE;
+	uint8_t Priority = SOUND_PRIO_COUNT;
+
+	while(Priority--)
+	{
+		if(SoundPlayers[Priority].Active)
+		{
+			Best = Priority;
+			break;
+		}
 	}
 
-	else if(Enable == HORN_ON)
+	if(Best == SoundOwner)
 	{
-		// Disable PWM
-		TCA0.SINGLE.CTRLA = 0;
-		TCA0.SINGLE.CTRLB &= ~TCA_SINGLE_CMP0EN_bm;
+		return;
+	}
 
-		HORN_PORT.DIRSET = HORN_BIT;
-		HORN_PORT.OUTSET = HORN_BIT;
+	if(SoundOwner != SOUND_OWNER_NONE && !SoundPlayers[SoundOwner].Resume)
+	{
+		SoundPlayers[SoundOwner].Active = 0;
 	}
 
-	else if(Enable == BELL || Enable == BELL_LOWVOLT || Enable == BELL_CHARGING)
+	SoundOwner = Best;
+
+	if(Best == SOUND_OWNER_NONE || Best == SOUND_PRIO_KILL)
+	{
+		Horn_Enable(HORN_OFF);
+	}
+	else if(SoundPlayers[Best].Sequence == 0)
 	{
+		Horn_Enable(HORN_ON);
+	}
+	else
+	{
+		// a resumed player carries on from the step it was on
 		Bell_Init();
+		Sound_LoadStep(&SoundPlayers[Best]);
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sound_LoadStep()
+//* Object              : load a player's current sequence step into TCA0
+//* Input Parameters    : SoundPlayer *Player = player to load
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sound_LoadStep(SoundPlayer *Player)
+{
+	const PWMSetting *Step = &Player->Sequence[Player->Index];
+
+	// Clamp the frequency to a valid range
+	uint16_t frequency = Step->frequency;
+	if (frequency < MIN_FREQ)
+	frequency = MIN_FREQ;
+	else if (frequency > MAX_FREQ)
+	frequency = MAX_FREQ;
+
+#if HORN_DUAL_TONE
+	if (Step->frequency2)
+	{
+		uint16_t frequency2 = Step->frequency2;
+		if (frequency2 < MIN_FREQ)
+		frequency2 = MIN_FREQ;
+		else if (frequency2 > MAX_FREQ)
+		frequency2 = MAX_FREQ;
+
+		Horn_SetDualTone(frequency, Step->duty_cycle, frequency2, Step->duty_cycle2);
+		return;
+	}
+#endif
+
+	Horn_SetTone(frequency, Step->duty_cycle);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sound_Update()
+//* Object              : step the player that owns the output, once for every tick passed
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Sound_Update(void)
+{
+	uint16_t Ticks = RTC_tickUpdate(&SoundOldTick);
+
+	// a late pass catches the sequence up a step at a time, until nothing is left to step
+	while(Ticks-- && Sound_Step())
+	{
 	}
 }
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sound_Step()
+//* Object              : one tick of the player that owns the output
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = 0 if there is no sequence playing to step
+//*--------------------------------------------------------------------------------------
+
+static uint8_t Sound_Step(void)
+{
+	if(SoundOwner == SOUND_OWNER_NONE)
+	{
+		return 0;
+	}
+
+	SoundPlayer *Player = &SoundPlayers[SoundOwner];
+
+	// HORN_ON and kill have no sequence to step
+	if(Player->Sequence == 0)
+	{
+		return 0;
+	}
+
+	if(Player->Timer)
+	{
+		Player->Timer--;
+		return 1;
+	}
+
+	Player->Index++; // Advance to the next step
+
+	if(Player->Sequence[Player->Index].TimeNextStep == 0)
+	{
+		// End of sequence, give the output to whatever is waiting
+		Player->Active = 0;
+		Sound_Arbitrate();
+	}
+	else
+	{
+		Sound_LoadStep(Player);
+		Player->Timer = Player->Sequence[Player->Index].TimeNextStep;
+	}
+
+	return 1;
+}
\ No newline at end of file
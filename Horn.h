@@ -11,14 +11,153 @@
 #ifndef HORN_H
 #define HORN_H
 
+//CCL bypass.  Needs a board with the horn gate on PA6 (LUT0-OUT), PB0 is not a CCL output.
+//The LUTs put the horn pin under hardware control, no firmware between them and the pin:
+//   LUT1  TCA0 WO0 (drive) AND (horn switch pressed OR TCA0 WO2 (bell, firmware gate bit))
+//   LUT0  LUT1 AND AC0 (pack above the DAC0 level) -> PA6
+//the switch reaches LUT1 through event channel ASYNCCH1.  Release and a pack sag cut the drive
+//within the LUT propagation delay, while firmware keeps the policy: TCA0 only runs once the honk
+//commits (BELL_DEBOUNCE_T, max on time by the drive budget, low battery lockout) and the CCL
+//is only enabled while Horn_IsDriving().  Bell sequences set WO2 so they play after release.
+#define HORN_CCL_BYPASS		0
+
+//Dual tone bell.  Needs a board with a second horn gate on PC3, both gates drive the transducer
+//so the two tones mix there.  TCA0 runs in split mode for sequence steps that have a second
+//frequency: the low half (WO0, the horn pin) plays frequency at duty_cycle, the high half (WO3,
+//PORTMUX to PC3) plays frequency2 at duty_cycle2, each with its own envelope from the table and
+//no interrupt per audio period.  The halves are 8 bit with one prescaler between them, DIV64 for
+//the bell, and Horn_SetDualTone() rounds each tone to whole counts of F_CPU / 64, 125kHz.
+//Tones closer than a count land on the same one and do not beat (1800Hz and 1810Hz are both
+//69 counts), so the bell table plays 69 counts, 1811.6Hz, against 70 counts, 1785.7Hz, a
+//25.9Hz beat.  Steps without a second frequency, and HORN_ON, use the normal 16 bit
+//dithered mode.
+//The CCL bypass gates WO0 from single mode WO2, so the two can not be built together.
+#define HORN_DUAL_TONE		0
+
+#if HORN_DUAL_TONE && HORN_CCL_BYPASS
+#error "HORN_DUAL_TONE and HORN_CCL_BYPASS both need TCA0 WO2 / single mode"
+#endif
+
+//Bridge drive.  Needs a board with the transducer between two half bridges, leg A gated from
+//the horn pin (TCA0 WO0) and leg B from PB2 (TCA0 WO2, inverted in the port).  TCA0 runs dual
+//slope: leg A is on while CNT < CMP0 and leg B while CNT >= CMP2, CMP2 = PER - CMP0, so the
+//transducer sees +Vbat then -Vbat each period, twice the swing of the single ended drive and
+//up to four times the power into the same load.  Every switching edge is a compare match, A
+//turning off and B on counting up, B off and A on counting down, with no edge at BOTTOM, so
+//the gap between the two legs never drops below HORN_BRIDGE_DEAD_NS (at least one count at the
+//slower prescalers).  Duty is each leg's share of its half period, 100% leaves only the dead
+//time.  A dual slope period is 2 x PER counts, the dither interrupt runs at BOTTOM as before.
+//The bell tables were tuned single ended and play up to ~6dB louder through the bridge.
+//HORN_ON drives the bridge with its carrier when HORN_BRIDGE_HORN_ON is set, for a passive
+//transducer; a horn with its own oscillator needs DC, so with it clear HORN_ON PWMs leg A and
+//holds leg B's low side on.
+#define HORN_BRIDGE			0
+#define HORN_BRIDGE_HORN_ON	0
+#define HORN_BRIDGE_DEAD_NS	500		// gate driver turn off plus margin
+
+#if HORN_BRIDGE && (HORN_CCL_BYPASS || HORN_DUAL_TONE)
+#error "HORN_BRIDGE needs TCA0 WO2 and single mode, it can not be built with HORN_CCL_BYPASS or HORN_DUAL_TONE"
+#endif
+
 //defines for charger I/O pins
+#if HORN_CCL_BYPASS
+#define HORN_PORT		PORTA
+#define HORN_PIN		6
+#else
 #define HORN_PORT		PORTB
 #define HORN_PIN		0
+#endif
 #define HORN_BIT		(1 << HORN_PIN)
 
-#define HORN_CPU_CLOCK	20000000UL
+#define HORN2_PORT		PORTC
+#define HORN2_PIN		3
+#define HORN2_BIT		(1 << HORN2_PIN)
+#define HORN2_PORTMUX	PORTMUX_TCA03_bm	// TCA0 WO3 from PA3 (EXT_IN) to PC3
+
+#define HORN_B_PORT		PORTB
+#define HORN_B_PIN		2
+#define HORN_B_BIT		(1 << HORN_B_PIN)
+#define HORN_B_CTRL		PORTB.PIN2CTRL		// INVEN, so port OUT set is leg B off
+
+#if HORN_BRIDGE
+#define HORN_WGMODE			TCA_SINGLE_WGMODE_DSBOTTOM_gc
+#define HORN_PERIOD_SHIFT	1						// a period is 2 x PER counts
+#define HORN_TOP(Counts)	(Counts)
+#define HORN_COUNTS_MAX		65535UL
+#else
+#define HORN_WGMODE			TCA_SINGLE_WGMODE_SINGLESLOPE_gc
+#define HORN_PERIOD_SHIFT	0						// a period is PER + 1 counts
+#define HORN_TOP(Counts)	((Counts) - 1)
+#define HORN_COUNTS_MAX		65536UL
+#endif
+#define HORN_BRIDGE_DEAD_CNT	((HORN_CPU_CLOCK / 1000000UL) * HORN_BRIDGE_DEAD_NS / 1000)	// at DIV1
+
+#define HORN_LEGS_ONE		1	// leg A only, leg B held off (single ended, or DC through the bridge)
+#define HORN_LEGS_BOTH		2	// differential
+
+#define HORN_CCL_SWITCH_GEN		EVSYS_ASYNCCH1_PORTB_PIN1_gc	// SWITCH_HORN pin
+#define HORN_CCL_TRUTH1			0xA2	// WO0 & (!SW | WO2), inputs IN2:IN1:IN0 -> bits 1, 5, 7
+#define HORN_CCL_TRUTH0			0x08	// LUT1 & AC0 -> bit 3
+
+#define HORN_MODE_UNKNOWN	0xFF	// Horn_Enable() has not set the pin up yet
+#define HORN_CLKSEL_NONE	0xFF	// TCA0 stopped, the next tone sets the prescaler
+
+#define HORN_CPU_CLOCK	F_CPU	// TCA0 runs off CLK_PER, 16MHz / 2
 #define MIN_FREQ 1			// Minimum frequency in Hz
 #define MAX_FREQ 20000		// Maximum frequency in Hz
+#define HORN_DUTY_FULL	1000	// 100% duty, the tables and drive work in 0.1% steps
+
+//Tone synthesis.  Each frequency gets the smallest TCA0 prescaler its period fits in, so the
+//audio range runs at DIV1 with 8MHz / f counts per period.  The fraction of a count left
+//over is dithered, the TCA0 overflow interrupt lengthens the right share of periods by one
+//count.  Cost is one ~30 cycle interrupt per period, 0.7% of the CPU at 1.8kHz and at most
+//7.5% at MAX_FREQ.  Accuracy at 8MHz (old fixed DIV64 / DIV1 / DIV1 dithered):
+//   1800Hz  1811.6Hz +0.64%  1800.180Hz +0.0100%  1800.0012Hz +0.00007%
+//   1810Hz  1811.6Hz +0.09%  1810.364Hz +0.0201%  1810.0011Hz +0.00006%
+//   2960Hz  2976.2Hz +0.55%  2960.770Hz +0.0260%  2960.0038Hz +0.00013%
+//   1145Hz  1146.8Hz +0.16%  1145.147Hz +0.0129%  1145.0002Hz +0.00002%
+//Duty resolution goes from 69 counts per period to 4444 at 1.8kHz.  tools/horn_tone plays
+//every table tone through a model of TCA0 and checks these figures.
+#define HORN_PER_DITHER	1		// 0 = integer periods only, no overflow interrupt
+
+//HORN_ON drive profile.  The horn is PWM'd above the audio band so its inrush
+//current ramps in instead of hitting the pack (and the AC0 low volt detector) at once
+#define HORN_DRIVE_FREQ			20000	// PWM carrier for HORN_ON in Hz
+#define HORN_SOFT_START_DUTY	10		// duty the ramp starts from, in percent
+#define HORN_SOFT_START_MS		20		// time to ramp up to 100% duty
+#define HORN_HOLD_MS			300		// full duty hold, the ear judges loudness on the onset
+#define HORN_SUSTAIN_DUTY		80		// duty after the hold period, in percent
+
+//Battery compensation.  Drive power goes as duty * Vbat^2, so every duty (HORN_ON and the
+//bell tables) is scaled by (nominal / Vbat)^2 using the ADC1 pack reading taken while honking
+#define HORN_COMP_NOMINAL_CNT	0x270	// 12 bit pack reading the duties are tuned for (LOW_VOLT_LOW_BATT_DAC_CNT << 4)
+#define HORN_COMP_MAX_Q8		512		// most the duty can be boosted on a sagging pack, 256 = 1.0
+#define HORN_COMP_FILTER_SHIFT	5		// low pass on the pack reading (~32 readings, 1024 a second) so horn ripple does not modulate duty
+
+//Drive budget, in place of a fixed maximum honk time.  Every mS the applied duty (0.1% steps),
+//weighted by HornCompQ8 once more since the current for the same power rises as the pack sags,
+//is added to two integrals:
+//   HornHeat    less 1/2^HORN_HEAT_TAU_SHIFT of itself every mS, first order thermal model (tau 32.8S)
+//   HornEnergy  this honk so far, cleared when HORN_ON starts
+//Past its FADE_START each one fades the HORN_ON duty linearly to 0 over 2^FADE_SHIFT, the lower
+//wins, and below HORN_BUDGET_MIN_Q8 the budget is spent and the honk ends.  Sustaining at 80%:
+//   cold horn, nominal pack     fade from 12.5S, silent at 24S
+//   cold horn, sagging pack     fade from 4.5S,  silent at 16.5S  (HornCompQ8 = 512)
+//   hot horn                    fades within a second to ~30% duty, where the heat holds level
+#define HORN_HEAT_TAU_SHIFT		15
+#define HORN_HEAT_STEP_MAX		256		// most mS of decay taken in one linear step
+#define HORN_HEAT_FADE_START	0x800000UL
+#define HORN_HEAT_FADE_SHIFT	21
+#define HORN_ENERGY_FADE_START	0xC00000UL
+#define HORN_ENERGY_FADE_SHIFT	21
+#define HORN_BUDGET_MIN_Q8		32
+
+//Horn_BudgetRead() values
+typedef enum {
+	HORN_BUDGET_SCALE,	// 0 HORN_ON duty scale, 256 = 1.0
+	HORN_BUDGET_HEAT,	// 1 HornHeat >> 10
+	HORN_BUDGET_ENERGY	// 2 HornEnergy >> 10
+} HornBudgetItem;
 
 typedef enum {
 	HORN_OFF,  // 0
@@ -32,13 +171,71 @@ typedef struct
 {
 	uint8_t TimeNextStep;	// in mS
 	uint16_t frequency;		// In Hertz
-	uint8_t duty_cycle;		// In percentage (0-100)
+	uint16_t duty_cycle;	// In 0.1% steps (0-HORN_DUTY_FULL)
+#if HORN_DUAL_TONE
+	uint16_t frequency2;	// second tone on HORN2 in Hertz, 0 = single tone step
+	uint16_t duty_cycle2;	// In 0.1% steps (0-HORN_DUTY_FULL)
+#endif
 } PWMSetting;
 
+//Sound priorities, highest wins the output
+typedef enum {
+	SOUND_PRIO_CHARGING,	// 0
+	SOUND_PRIO_LOWBATT,		// 1
+	SOUND_PRIO_BELL,		// 2
+	SOUND_PRIO_HORN,		// 3
+	SOUND_PRIO_KILL,		// 4
+	SOUND_PRIO_COUNT		// 5
+} SoundPriority;
+
+#define SOUND_OWNER_NONE	0xFF
+
+typedef struct
+{
+	const PWMSetting *Sequence;	// bound once at start, 0 for HORN_ON and kill
+	uint16_t Timer;				// mS left on the current step
+	uint8_t Index;				// current step
+	uint8_t Active;				// playing or waiting to play
+	uint8_t Resume;				// 1 = carry on after being preempted, 0 = drop
+} SoundPlayer;
+
+typedef struct
+{
+	uint8_t Priority;			// SoundPriority, SOUND_OWNER_NONE if not a sound
+	uint8_t Resume;
+	const PWMSetting *Sequence;
+} SoundBinding;
+
+typedef enum {
+	HORN_DRIVE_RAMP,	// 0
+	HORN_DRIVE_HOLD,	// 1
+	HORN_DRIVE_SUSTAIN	// 2
+} HornDrivePhase;
+
+typedef struct
+{
+	uint16_t RampTime_mS;	// soft start time from HORN_SOFT_START_DUTY to 100%
+	uint16_t HoldTime_mS;	// time held at 100% before settling
+	uint8_t SustainDuty;	// In percentage (0-100)
+} HornDriveProfile;
+
 
 //Prototypes
 void Bell_Init();
 void Horn_Enable(uint8_t Enable);
-uint8_t Bell_Update(SpeakerState speaker_state);
+void Horn_CclInit(void);
+void Horn_Update(void);
+uint8_t Horn_IsDriving(void);
+uint8_t Horn_IsHonking(void);
+uint16_t Horn_HonkTime(void);
+uint8_t Horn_BudgetSpent(void);
+uint16_t Horn_BudgetRead(uint8_t Which);
+void Horn_SetDriveProfile(uint16_t RampTime_mS, uint16_t HoldTime_mS, uint8_t SustainDuty);
+void Sound_Start(SpeakerState Sound);
+void Sound_Stop(SpeakerState Sound);
+uint8_t Sound_IsPlaying(SpeakerState Sound);
+SpeakerState Sound_Current(void);
+void Sound_Kill(uint8_t Enable);
+void Sound_Update(void);
 
 #endif /* HORN_H */
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <avr/io.h>
 #include "Timer.h"
 #include "Led.h"
+#include "Gpio.h"
 
 //Variables Global to the LED functions
 uint16_t Status_Led_oldtick;				//used for status LED timing
@@ -27,11 +28,11 @@ uint16_t Status_Led_Timer;					//used for status flash rate
 void LED_init(void)
 {
    //Status_Led_Timer = TIME_LED_STATUS_HEARTBEAT;
-   LED_RED_PORT.OUTCLR = LED_RED_BIT;
-   LED_GREEN_PORT.OUTCLR = LED_GREEN_BIT;
+   GPIO_CLR(LED_RED);
+   GPIO_CLR(LED_GREEN);
 
-   LED_RED_PORT.DIRSET = LED_RED_BIT;
-   LED_GREEN_PORT.DIRSET = LED_GREEN_BIT;
+   GPIO_OUTPUT(LED_RED);
+   GPIO_OUTPUT(LED_GREEN);
 
    Status_Led_Timer = TIME_LED_STATUS_HEARTBEAT;
 }
@@ -46,14 +47,7 @@ void LED_init(void)
 
 void LED_Red(uint8_t Enable)
 {
-	if(Enable)
-	{
-		LED_RED_PORT.OUTSET = LED_RED_BIT;
-	}
-	else
-	{
-		LED_RED_PORT.OUTCLR = LED_RED_BIT;
-	}
+	GPIO_WRITE(LED_RED, Enable);
 }
 
 
@@ -66,14 +60,7 @@ void LED_Red(uint8_t Enable)
 
 void LED_Green(uint8_t Enable)
 {
-	if(Enable)
-	{
-		LED_GREEN_PORT.OUTSET = LED_GREEN_BIT;
-	}
-	else
-	{
-		LED_GREEN_PORT.OUTCLR = LED_GREEN_BIT;
-	}
+	GPIO_WRITE(LED_GREEN, Enable);
 }
 
 
@@ -87,18 +74,18 @@ void LED_Green(uint8_t Enable)
 
 void LED_update()
 {
-	if(RTC_getTick() != Status_Led_oldtick)
-	{
-		Status_Led_oldtick = RTC_getTick();
+	uint16_t Ticks = RTC_tickUpdate(&Status_Led_oldtick);
 
-		if(Status_Led_Timer)
+	if(Ticks)
+	{
+		if(Status_Led_Timer > Ticks)
 		{
-			Status_Led_Timer--;
+			Status_Led_Timer -= Ticks;
 		}
 
 		else
 		{
-			LED_RED_PORT.OUTTGL = LED_RED_BIT;
+			GPIO_TGL(LED_RED);
 			Status_Led_Timer = TIME_LED_STATUS_HEARTBEAT;
 		}
 	}        
@@ -13,13 +13,21 @@
 #include <avr/interrupt.h>
 #include <avr/wdt.h>
 #include "Timer.h"
+#include "Task.h"
 #include "LowVoltKill.h"
 #include "Switch.h"
 #include "Horn.h"
 #include "Led.h"
-#include "Config.h"
-
-uint16_t LowVoltDetectCount;
+#include "Gpio.h"
+#include "ADC.h"
+#include "Profile.h"
+#include "Event.h"
+#include "Sag.h"
+#include "Cell.h"
+#include "Diag.h"
+
+uint16_t LowVoltCusum;
+uint8_t LowVoltBattCount;
 uint8_t LowVoltDetected;
 uint16_t LowVoltkillTimer_mS;
 uint16_t LowVoltkillOldTick;
@@ -31,6 +39,25 @@ uint16_t MiniHonkTimer_mS;
 SpeakerState BellState;
 uint8_t StartedByButton;
 
+Task LowVoltBootTask;
+
+uint8_t LowVoltAfeOn;			// AC0 / DAC0 enabled
+uint8_t LowVoltAfeSettle;		// ticks left before the AC0 state can be used
+uint8_t LowVoltAfeSampling;		// a parked PIT sample is waiting to settle
+uint8_t LowVoltPitCount;
+uint8_t LowVoltCellPitCount;	// last PIT period a rested cell pass was scored in
+uint8_t LowVoltTripped;			// AC0 tripped since the last honking sample
+
+//local Functions
+static uint8_t LowVoltKill_BootCheck(void);
+static void LowVoltDetect_Update(void);
+static void LowVoltDetect_Add(int16_t Score);
+static void LowVoltAnalog_Update(uint16_t Ticks);
+static uint16_t LowVoltTimer_Step(uint16_t Timer_mS, uint16_t Ticks);
+#if ADC_CELL_TAPS_FITTED
+static void LowVoltCell_Update(void);
+#endif
+
 //*--------------------------------------------------------------------------------------
 //* Function Name       : LowVoltKill_init()
 //* Object              : initialize the AC and DAC for fast shutdown
@@ -41,62 +68,524 @@ uint8_t StartedByButton;
 void LowVoltKill_init(void)
 {
 	//configure pins
-	VOLT_KILL_AC_PORT.OUTCLR = VOLT_KILL_AC_BIT;
-	VOLT_KILL_ADC_PORT.OUTCLR = VOLT_KILL_ADC_BIT;
+	GPIO_CLR(VOLT_KILL_AC);
+	GPIO_CLR(VOLT_KILL_ADC);
 
 	//disable inputs
 	VOLT_KILL_AC_CTRL = (4 << PORT_ISC0_bp);
 	VOLT_KILL_ADC_CTRL = (4 << PORT_ISC0_bp);
    
-	//Setup DAC
-	DAC0.CTRLA = DAC_OUTEN_bm | DAC_ENABLE_bm;
+	//Setup DAC, internal to AC0 only so the output pin stays off
 	VREF.CTRLA = VREF_DAC0REFSEL_1V1_gc | VREF_ADC0REFSEL_1V1_gc;
 	DAC0.DATA = LOW_VOLT_KILL_DAC_CNT;
    
-	//Setup AC
+	//Setup AC, powered by LowVoltKill_analogPower()
 	AC0.MUXCTRLA = AC_MUXPOS_PIN0_gc | AC_MUXNEG_DAC_gc | (0 << AC_INVERT_bp);
-	AC0.CTRLA = AC_RUNSTDBY_bm| AC_ENABLE_bm | AC_INTMODE_POSEDGE_gc;
-	
+	LowVoltKill_analogPower(1);
+
+	RTC_pitInit(RTC_PERIOD_CYC1024_gc);
+	RTC_pitInterrupt(1);
+
 	LowVoltState = LOW_VOLT_STATE_INIT;
 	MiniHonkTimer_mS = 0;
 }
 
 
 //*--------------------------------------------------------------------------------------
-//* Function Name       : LowVoltKill_update
-//* Object              : Update the Low Voltage kill function
+//* Function Name       : LowVoltKill_analogPower()
+//* Object              : turn the AC0 / DAC0 comparator chain on or off, VREF follows them
+//* Input Parameters    : uint8_t On = 1 on, 0 off
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void LowVoltKill_analogPower(uint8_t On)
+{
+	if(On)
+	{
+		// no AC0 interrupt, TCB0 times the sags from the output event.  10mV of hysteresis,
+		// about a DAC0 step either side, so carrier ripple at the level does not chatter it
+		DAC0.CTRLA = DAC_ENABLE_bm;
+		AC0.CTRLA = AC_ENABLE_bm | AC_HYSMODE_10mV_gc;
+
+		if(!LowVoltAfeOn)
+		{
+			LowVoltAfeSettle = LOW_VOLT_AFE_SETTLE_MS;
+		}
+	}
+	else
+	{
+		SAG_CLOSE();
+		AC0.CTRLA = 0;
+		DAC0.CTRLA = 0;
+		LowVoltAfeSampling = 0;
+	}
+
+	LowVoltAfeOn = On;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_event()
+//* Object              : take the sag and ADC1 window events from the main loop.  A sag of
+//*                       SAG_MIN_US or more is latched so a dip between two 1mS samples
+//*                       still counts, carrier ripple never gets this far.  A pack reading
+//*                       below the window while parked takes a sample now instead of
+//*                       waiting for the PIT
+//* Input Parameters    : const Event *Ev = EVENT_SAG or EVENT_ADC_WINDOW
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void LowVoltKill_event(const Event *Ev)
+{
+	if(Ev->Type == EVENT_SAG)
+	{
+		if(LowVoltAfeSettle == 0)
+		{
+			LowVoltTripped = 1;
+		}
+	}
+	else if(Ev->Type == EVENT_ADC_WINDOW && Ev->Data)
+	{
+		if(!LowVoltAfeOn && LowVoltState != LOW_VOLT_STATE_DEAD)
+		{
+			LowVoltKill_analogPower(1);
+			LowVoltAfeSampling = 1;
+		}
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_isDead()
+//* Object              : has the pack been found dead
 //* Input Parameters    : none
+//* Output Parameters   : uint8_t = 1 in LOW_VOLT_STATE_DEAD
+//*--------------------------------------------------------------------------------------
+
+uint8_t LowVoltKill_isDead(void)
+{
+	return (LowVoltState == LOW_VOLT_STATE_DEAD);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_checkpoint()
+//* Object              : copy the state machine out for Resume.c, also called from the
+//*                       BOD VLM interrupt
+//* Input Parameters    : ResumeCheckpoint *Checkpoint = where to put it
 //* Output Parameters   : none
 //*--------------------------------------------------------------------------------------
 
-void LowVoltKill_update(void)
+void LowVoltKill_checkpoint(ResumeCheckpoint *Checkpoint)
 {
-	if(RTC_getTick() != LowVoltkillOldTick)
+	Checkpoint->State = LowVoltState;
+	Checkpoint->BellState = BellState;
+	Checkpoint->Sound = Sound_Current();
+	Checkpoint->SwitchPressed = SwitchHornGetStatus();
+	Checkpoint->Detected = LowVoltDetected;
+	Checkpoint->Cusum = LowVoltCusum;
+	Checkpoint->KillTimer_mS = LowVoltkillTimer_mS;
+	Checkpoint->BellDebounceTimer_mS = BellDebounceTimer_mS;
+	Checkpoint->MiniHonkTimer_mS = MiniHonkTimer_mS;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_resume()
+//* Object              : warm reset, carry on from a checkpoint after LowVoltKill_init().
+//*                       The boot check and BELL_DEBOUNCE_T already passed before the reset
+//*                       so a honk that was sounding starts again straight away
+//* Input Parameters    : const ResumeCheckpoint *Checkpoint
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void LowVoltKill_resume(const ResumeCheckpoint *Checkpoint)
+{
+	if(Checkpoint->State == LOW_VOLT_STATE_INIT || Checkpoint->State == LOW_VOLT_STATE_KILL ||
+	   Checkpoint->State > LOW_VOLT_STATE_DEAD)
 	{
-		LowVoltkillOldTick = RTC_getTick();
+		return;
+	}
 
-		if(LowVoltkillTimer_mS)
+	LowVoltState = Checkpoint->State;
+	BellState = Checkpoint->BellState;
+	LowVoltDetected = Checkpoint->Detected;
+	LowVoltCusum = Checkpoint->Cusum;
+	LowVoltkillTimer_mS = Checkpoint->KillTimer_mS;
+	BellDebounceTimer_mS = Checkpoint->BellDebounceTimer_mS;
+	MiniHonkTimer_mS = Checkpoint->MiniHonkTimer_mS;
+
+	SwitchResume(Checkpoint->SwitchPressed);
+
+	if(Checkpoint->Sound != HORN_OFF && LowVoltState != LOW_VOLT_STATE_DEAD)
+	{
+		Sound_Start(Checkpoint->Sound);
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltAnalog_Update()
+//* Object              : once per tick, run the comparator chain continuously while the
+//*                       horn can load the pack, otherwise one settled sample per PIT period.
+//*                       A settled high AC0 tells Sag.c its captures are real
+//* Input Parameters    : uint16_t Ticks = ticks since the last call
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void LowVoltAnalog_Update(uint16_t Ticks)
+{
+	LowVoltAfeSettle = (LowVoltAfeSettle > Ticks) ? LowVoltAfeSettle - Ticks : 0;
+
+	if(LowVoltAfeOn && LowVoltAfeSettle == 0 && (AC0.STATUS & AC_STATE_bm))
+	{
+		SAG_HIGH();
+	}
+
+	if(LowVoltState == LOW_VOLT_STATE_DEAD)
+	{
+		if(LowVoltAfeOn)
 		{
-			LowVoltkillTimer_mS--;
+			LowVoltKill_analogPower(0);
 		}
+	}
+	else if(LowVoltState == LOW_VOLT_STATE_INIT || LowVoltState == LOW_VOLT_STATE_KILL ||
+			LowVoltState == LOW_VOLT_STATE_CHECK_HORN1 || Horn_IsDriving())
+	{
+		LowVoltAfeSampling = 0;
+
+		if(!LowVoltAfeOn)
+		{
+			LowVoltKill_analogPower(1);
+		}
+	}
+	else if(LowVoltAfeSampling)
+	{
+		if(LowVoltAfeSettle == 0)
+		{
+			if(AC0.STATUS & AC_STATE_bm)
+			{
+				LowVoltDetect_Add(-LOW_VOLT_CUSUM_REST_OK);
+			}
+			else
+			{
+				LowVoltDetect_Add(LOW_VOLT_CUSUM_REST_LOW);
+			}
+
+			LowVoltKill_analogPower(0);
+		}
+	}
+	else if(RTC_pitUpdate(&LowVoltPitCount))
+	{
+		LowVoltKill_analogPower(1);
+		LowVoltAfeSampling = 1;
+	}
+	else if(LowVoltAfeOn)
+	{
+		LowVoltKill_analogPower(0);
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltTimer_Step()
+//* Object              : count a mS timer down by the ticks passed, stopping at 0
+//* Input Parameters    : uint16_t Timer_mS, uint16_t Ticks = ticks since the last call
+//* Output Parameters   : uint16_t = what is left of the timer
+//*--------------------------------------------------------------------------------------
+
+static uint16_t LowVoltTimer_Step(uint16_t Timer_mS, uint16_t Ticks)
+{
+	return (Timer_mS > Ticks) ? Timer_mS - Ticks : 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_BootCheck()
+//* Object              : power up check, the pack has to stay above the kill level for
+//*                       LOW_VOLT_KILL_TIMEOUT before the horn is allowed
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = TASK_WAITING until the check is finished
+//*--------------------------------------------------------------------------------------
+
+static uint8_t LowVoltKill_BootCheck(void)
+{
+	Task *t = &LowVoltBootTask;
+
+	TASK_BEGIN(t);
+
+	DAC0.DATA = LOW_VOLT_KILL_DAC_CNT;
+	TASK_AWAIT(t, LowVoltAfeSettle == 0);
+
+	t->Tick = RTC_getTick();
+	TASK_AWAIT(t, !(AC0.STATUS & AC_STATE_bm) || RTC_elapsedMS(t->Tick) >= LOW_VOLT_KILL_TIMEOUT);
+
+	if(!(AC0.STATUS & AC_STATE_bm))
+	{
+		LowVoltState = LOW_VOLT_STATE_DEAD;
+	}
+	else
+	{
+		DAC0.DATA = LOW_VOLT_LOW_BATT_DAC_CNT;
+
+		// pretend like horn was pressed no matter what
+		LowVoltState = LOW_VOLT_STATE_CHECK_HORN1;
+	}
+
+	TASK_END(t);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltDetect_Add()
+//* Object              : add a score to the low battery CUSUM and flag low battery
+//* Input Parameters    : int16_t Score = + for evidence of a low pack, - for a good one
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void LowVoltDetect_Add(int16_t Score)
+{
+	int16_t Sum = (int16_t)LowVoltCusum + Score;
+
+	if(Sum <= 0)
+	{
+		LowVoltCusum = 0;
+	}
+	else if(Sum >= LOW_VOLT_CUSUM_THRESHOLD)
+	{
+		LowVoltCusum = LOW_VOLT_CUSUM_THRESHOLD;
+		LowVoltDetected = 1;
+		LED_Red(1);
+	}
+	else
+	{
+		LowVoltCusum = Sum;
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltDetect_Update()
+//* Object              : feed this mS of AC0, and any new pack reading, to the detector
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void LowVoltDetect_Update(void)
+{
+	if(LowVoltAfeSettle)
+	{
+		// comparator still settling, the ADC1 reading below covers it
+	}
+	else if((AC0.STATUS & AC_STATE_bm) && !LowVoltTripped)
+	{
+		LowVoltDetect_Add(-LOW_VOLT_CUSUM_OK);
+	}
+	else
+	{
+		LowVoltDetect_Add(LOW_VOLT_CUSUM_LOW);
+	}
+
+	LowVoltTripped = 0;
+
+	uint16_t Battery;
+
+	if(ADC_BattSenseUpdate(&LowVoltBattCount, &Battery))
+	{
+		int16_t Score = (int16_t)LOW_VOLT_CUSUM_ADC_LEVEL - (int16_t)Battery - LOW_VOLT_CUSUM_ADC_ALLOW;
+
+		if(Score > LOW_VOLT_CUSUM_ADC_MAX)
+		{
+			Score = LOW_VOLT_CUSUM_ADC_MAX;
+		}
+		else if(Score < -LOW_VOLT_CUSUM_ADC_MAX)
+		{
+			Score = -LOW_VOLT_CUSUM_ADC_MAX;
+		}
+
+		LowVoltDetect_Add(Score);
+	}
+}
+
+
+#if ADC_CELL_TAPS_FITTED
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltCell_Update()
+//* Object              : once per tick, feed a new pass of the cell taps to the detector on
+//*                       the weakest cell.  A loaded cell under CELL_CUTOFF_MV ends the honk
+//*                       and flags low battery at once, the pack can still look healthy.
+//*                       Rested passes come every few ticks, only the first one in each PIT
+//*                       period is scored so the weight matches the parked AC0 sample
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void LowVoltCell_Update(void)
+{
+	uint8_t Load = Cell_Update();
+
+	if(Load == CELL_NONE || LowVoltState == LOW_VOLT_STATE_INIT || LowVoltState == LOW_VOLT_STATE_KILL ||
+	   LowVoltState == LOW_VOLT_STATE_DEAD)
+	{
+		return;
+	}
+
+	uint16_t Weakest_mV = Cell_Read(Load, Cell_Weakest(Load));
+
+	if(Load == CELL_RESTED)
+	{
+		if(RTC_pitUpdate(&LowVoltCellPitCount) && Weakest_mV < CELL_REST_LOW_MV)
+		{
+			LowVoltDetect_Add(LOW_VOLT_CUSUM_REST_LOW);
+		}
+	}
+	else if(Weakest_mV < CELL_CUTOFF_MV && Horn_IsHonking())
+	{
+		SwitchClearHornStatus();
+		LowVoltDetect_Add(LOW_VOLT_CUSUM_THRESHOLD);
+	}
+	else if(Weakest_mV < CELL_LOW_MV)
+	{
+		LowVoltDetect_Add(LOW_VOLT_CUSUM_LOW);
+	}
+}
+#endif
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_checkBellMiniBell()
+//* Object              : PROFILE_MINIBELL LOW_VOLT_STATE_CHECK_BELL, ring the bell out after
+//*                       a release, then wait for the horn or the low battery warning
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void LowVoltKill_checkBellMiniBell(void)
+{
+	if(Sound_IsPlaying(BellState))
+	{
+		if(SwitchHornGetStatus())
+		{
+			BellDebounceTimer_mS = BELL_DEBOUNCE_T;
+			BellState = BELL;
+			LED_Green(1);
+
+			LowVoltState = LOW_VOLT_STATE_CHECK_HORN1;
+		}
+	
+		else if(LowVoltkillTimer_mS == 0 && LowVoltDetected)
+		{
+			// queued behind the bell, the arbiter plays it when the bell is done
+			Sound_Start(BELL_LOWVOLT);
+			LED_Green(0);
+
+			LowVoltkillTimer_mS = LOW_VOLT_LOW_BATT_BEEP;
+			LowVoltState = LOW_VOLT_STATE_END_BEEP;
+		}
+	}
+	else
+	{
+		LowVoltkillTimer_mS = LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP;
+		LowVoltState = LOW_VOLT_STATE_CHECK_HORN0;
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_releaseMiniBell()
+//* Object              : PROFILE_MINIBELL horn release, the bell takes over from the horn
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void LowVoltKill_releaseMiniBell(void)
+{
+	BellState = BELL;
+	Sound_Stop(HORN_ON);
+	Sound_Start(BellState);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_checkBellMini()
+//* Object              : PROFILE_MINI LOW_VOLT_STATE_CHECK_BELL, a short honk extension
+//*                       instead of the bell
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void LowVoltKill_checkBellMini(void)
+{
+	if(MiniHonkTimer_mS == 0)
+	{
+		// Do a short honk extension
+		Sound_Start(HORN_ON);
+		MiniHonkTimer_mS = ProfileActive->MiniHonk_mS;
+		
+		if(SwitchHornGetStatus())
+		{
+			BellDebounceTimer_mS = BELL_DEBOUNCE_T;
+			LED_Green(1);
+
+			LowVoltState = LOW_VOLT_STATE_CHECK_HORN1;
+		}
+		else if(LowVoltkillTimer_mS == 0 && LowVoltDetected)
+		{
+			LED_Green(0);
+			LowVoltkillTimer_mS = LOW_VOLT_LOW_BATT_BEEP;
+			
+			// For both modes, we properly initialize the low battery bell
+			Sound_Start(BELL_LOWVOLT);
+			
+			LowVoltState = LOW_VOLT_STATE_END_BEEP;
+		}
+		else
+		{
+			LowVoltkillTimer_mS = LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP;
+			LowVoltState = LOW_VOLT_STATE_CHECK_HORN0;
+		}
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : LowVoltKill_update
+//* Object              : Update the Low Voltage kill function
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void LowVoltKill_update(void)
+{
+	// the timers step by the ticks passed, the state machine runs once a pass
+	uint16_t Ticks = RTC_tickUpdate(&LowVoltkillOldTick);
+
+	if(Ticks)
+	{
+		LowVoltkillTimer_mS = LowVoltTimer_Step(LowVoltkillTimer_mS, Ticks);
 
 		// see if you have been holding the button down long enough to honk or not
 		if(BellDebounceTimer_mS)
 		{
-			BellDebounceTimer_mS--;
+			BellDebounceTimer_mS = LowVoltTimer_Step(BellDebounceTimer_mS, Ticks);
 			LED_Red(1);
 		}
 		else{
 			LED_Red(0);
 		}
+
+		LowVoltAnalog_Update(Ticks);
+#if ADC_CELL_TAPS_FITTED
+		LowVoltCell_Update();
+#endif
 		
 		// Mini honk extension timer
 		if(MiniHonkTimer_mS)
 		{
-			MiniHonkTimer_mS--;
+			MiniHonkTimer_mS = LowVoltTimer_Step(MiniHonkTimer_mS, Ticks);
 			if(MiniHonkTimer_mS == 0)
 			{
-				Horn_Enable(HORN_OFF);
+				Sound_Stop(HORN_ON);
 			}
 		}
 
@@ -104,13 +593,12 @@ void LowVoltKill_update(void)
 		{
 			case LOW_VOLT_STATE_INIT:
 			{
-				DAC0.DATA = LOW_VOLT_KILL_DAC_CNT;
-				LowVoltkillTimer_mS = LOW_VOLT_KILL_TIMEOUT; // 10
+				TASK_INIT(&LowVoltBootTask);
 				BellDebounceTimer_mS = BELL_DEBOUNCE_T;
 				BellState = BELL;
 				MiniHonkTimer_mS = 0;
 
-				LowVoltDetectCount = 0;
+				LowVoltCusum = 0;
 				LowVoltDetected = 0;
 
 				LowVoltState = LOW_VOLT_STATE_KILL;
@@ -130,26 +618,7 @@ void LowVoltKill_update(void)
 			//if battery already low without honking horn.  Just shut down with Red LED on
 			case LOW_VOLT_STATE_KILL:
 			{
-				if(!(AC0.STATUS & AC_STATE_bm))
-				{
-					LowVoltState = LOW_VOLT_STATE_DEAD;
-				}
-
-				if(LowVoltkillTimer_mS == 0)
-				{
-					
-					DAC0.DATA = LOW_VOLT_LOW_BATT_DAC_CNT;
-					LowVoltkillTimer_mS = LOW_VOLT_TIME_MAX_HORN_ON_TIME;
-					if(SwitchHornGetStatus())
-					{
-						LowVoltState = LOW_VOLT_STATE_CHECK_HORN1;
-					}
-					else
-					{ // pretend like horn was pressed no matter what 
-						LowVoltState = LOW_VOLT_STATE_CHECK_HORN1;
-					}
-				}
-				
+				LowVoltKill_BootCheck();
 				break;
 			}
 			
@@ -157,67 +626,7 @@ void LowVoltKill_update(void)
 			//Ring Bell for end of cycle or do mini honk extension
 			case LOW_VOLT_STATE_CHECK_BELL:
 			{
-				#if CONFIG_MODE == CONFIG_MODE_MINIBELL
-				// Original bell behavior
-				if(Bell_Update(BellState))
-				{
-					if(SwitchHornGetStatus())
-					{
-						LowVoltkillTimer_mS = LOW_VOLT_TIME_MAX_HORN_ON_TIME;
-						BellDebounceTimer_mS = BELL_DEBOUNCE_T;
-						BellState = BELL;
-						LED_Green(1);
-
-						LowVoltState = LOW_VOLT_STATE_CHECK_HORN1;
-					}
-				
-					else if(LowVoltkillTimer_mS == 0 && LowVoltDetected)
-					{
-						Bell_Init();
-						LED_Green(0);
-
-						LowVoltkillTimer_mS = LOW_VOLT_LOW_BATT_BEEP;
-						LowVoltState = LOW_VOLT_STATE_END_BEEP;
-					}
-				}
-				else
-				{
-					LowVoltkillTimer_mS = LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP;
-					LowVoltState = LOW_VOLT_STATE_CHECK_HORN0;
-				}
-				#else
-				// Mini mode - short honk extension instead of bell
-				if(MiniHonkTimer_mS == 0)
-				{
-					// Do a short honk extension
-					Horn_Enable(HORN_ON);
-					MiniHonkTimer_mS = MINI_HONK_EXTENSION_TIME;
-					
-					if(SwitchHornGetStatus())
-					{
-						LowVoltkillTimer_mS = LOW_VOLT_TIME_MAX_HORN_ON_TIME;
-						BellDebounceTimer_mS = BELL_DEBOUNCE_T;
-						LED_Green(1);
-
-						LowVoltState = LOW_VOLT_STATE_CHECK_HORN1;
-					}
-					else if(LowVoltkillTimer_mS == 0 && LowVoltDetected)
-					{
-						LED_Green(0);
-						LowVoltkillTimer_mS = LOW_VOLT_LOW_BATT_BEEP;
-						
-						// For both modes, we properly initialize the low battery bell
-						Horn_Enable(BELL_LOWVOLT);
-						
-						LowVoltState = LOW_VOLT_STATE_END_BEEP;
-					}
-					else
-					{
-						LowVoltkillTimer_mS = LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP;
-						LowVoltState = LOW_VOLT_STATE_CHECK_HORN0;
-					}
-				}
-				#endif
+				ProfileActive->CheckBell();
 
 				break;
 			}
@@ -228,13 +637,12 @@ void LowVoltKill_update(void)
 				// Only turn off horn if mini honk timer is not active
 				if(MiniHonkTimer_mS == 0)
 				{
-					Horn_Enable(HORN_OFF);
+					Sound_Stop(HORN_ON);
 				}
 
 				if(SwitchHornGetStatus())
 				{
 					LED_Green(1);
-					LowVoltkillTimer_mS = LOW_VOLT_TIME_MAX_HORN_ON_TIME;
 					BellDebounceTimer_mS = BELL_DEBOUNCE_T;
 					BellState = BELL;
 					// go on to the next state where it will maybe honk
@@ -246,7 +654,7 @@ void LowVoltKill_update(void)
 					LowVoltkillTimer_mS = LOW_VOLT_LOW_BATT_BEEP;
 					
 					// For both modes, we properly initialize the low battery bell
-					Horn_Enable(BELL_LOWVOLT);
+					Sound_Start(BELL_LOWVOLT);
 					
 					LowVoltState = LOW_VOLT_STATE_END_BEEP;
 				}
@@ -262,33 +670,18 @@ void LowVoltKill_update(void)
 				{
 					// if you are commited to honk
 					if (BellDebounceTimer_mS == 0){
-						Horn_Enable(HORN_ON);
+						Sound_Start(HORN_ON);
 						LED_Green(1);
 					}
 
-					//stop honking horn if max on time expired
-					if(LowVoltkillTimer_mS == 0)
+					//stop honking horn once the drive budget has faded it out, Horn.h
+					if(Horn_BudgetSpent())
 					{
 						SwitchClearHornStatus();
 					}
 
 					//check Low battery condition over time
-					if(!(AC0.STATUS & AC_STATE_bm))
-					{
-						LowVoltDetectCount++;
-						if(LowVoltDetectCount >= LOW_VOLT_LOW_BATT_DET_TIME)
-						{
-							LowVoltDetected = 1;
-							LED_Red(1);
-						}
-					}
-					else
-					{
-						if(LowVoltDetectCount)
-						{
-							LowVoltDetectCount--;
-						}
-					}
+					LowVoltDetect_Update();
 				}
 				else
 				{
@@ -296,11 +689,11 @@ void LowVoltKill_update(void)
 
 					LowVoltkillTimer_mS = LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP;
 					LowVoltState = LOW_VOLT_STATE_CHECK_BELL;
-					
-					#if CONFIG_MODE == CONFIG_MODE_MINIBELL
-					BellState = BELL;
-					Horn_Enable(BellState);
-					#endif
+
+					if(ProfileActive->Release)
+					{
+						ProfileActive->Release();
+					}
 				}
 				break;
 			}
@@ -312,9 +705,10 @@ void LowVoltKill_update(void)
 
 				if(SwitchHornGetStatus())
 				{
-					LowVoltkillTimer_mS = LOW_VOLT_TIME_MAX_HORN_ON_TIME;
 					BellDebounceTimer_mS = BELL_DEBOUNCE_T;
 
+					// the rider is back on the horn, do not pick the warning up again after
+					Sound_Stop(BELL_LOWVOLT);
 					BellState = BELL;
 					LED_Green(1);
 					
@@ -324,13 +718,10 @@ void LowVoltKill_update(void)
 				{
 					LED_Green(0);
 
-					// Both config modes use the same Bell_Update for low battery
-					if(Bell_Update(BELL_LOWVOLT) == 0)
+					// Both config modes use the same low battery sequence
+					if(Sound_IsPlaying(BELL_LOWVOLT) == 0)
 					{
-						// If the Bell_Update returns 0, the sequence is done
-						// Make sure to turn the horn off completely
-						Horn_Enable(HORN_OFF);
-						
+						// the sequence is done and the arbiter has turned the output off
 						// Reset timer to prevent any further action
 						if(LowVoltkillTimer_mS != 0)
 						{
@@ -345,6 +736,7 @@ void LowVoltKill_update(void)
 			case LOW_VOLT_STATE_DEAD:
 			{
 				LED_Red(1);
+				Sound_Kill(1);
 				break;
 			}
 		}
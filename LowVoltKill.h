@@ -12,17 +12,70 @@
 #ifndef LOWVOLTKILL_H
 #define LOWVOLTKILL_H
 
+#include "Event.h"
+#include "Resume.h"
 
-//Timing Defines
-#define LOW_VOLT_KILL_DAC_CNT				0x24	
-#define LOW_VOLT_LOW_BATT_DAC_CNT			0x27  
+
+//Timing Defines.  The tuned ones can be overridden from the command line, or by the
+//tools/lvk_sim optimizer which builds this module on the host with them as variables
+#ifndef LOW_VOLT_KILL_DAC_CNT
+#define LOW_VOLT_KILL_DAC_CNT				0x24
+#endif
+#ifndef LOW_VOLT_LOW_BATT_DAC_CNT
+#define LOW_VOLT_LOW_BATT_DAC_CNT			0x27
+#endif
 #define LOW_VOLT_KILL_TIMEOUT				10
-#define LOW_VOLT_LOW_BATT_DET_TIME			100
+#ifndef LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP
 #define LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP	1500 // time delay from honk
+#endif
 #define LOW_VOLT_LOW_BATT_BEEP				2000  // length of time it is honking for
-#define LOW_VOLT_TIME_MAX_HORN_ON_TIME		10000 // how long you can honk the horn for before it turns off
 // amount of time to decide if you mean to honk, or only mean to ring the bell
+#ifndef BELL_DEBOUNCE_T
 #define BELL_DEBOUNCE_T 100 // change to 400 for quieter debugging
+#endif
+
+//Low battery detector.  CUSUM on the AC0 state sampled every mS while honking: a low sample
+//adds LOW_VOLT_CUSUM_LOW, a good one takes off LOW_VOLT_CUSUM_OK (floored at 0) and low
+//battery is set when the sum reaches LOW_VOLT_CUSUM_THRESHOLD.  The weights follow the log
+//likelihood ratio of a healthy pack (~5% of samples low on sag noise) to a failing one (~50%)
+//   pack always low         delay = THRESHOLD / LOW                 = 20mS
+//   pack low half the time  delay = THRESHOLD * 2 / (LOW - OK)      = 58mS
+//   no drift (never alarms)       = OK / (LOW + OK)                 = 24% of samples low
+//Raise THRESHOLD for fewer false alarms (mean run length grows about exponentially with it),
+//lower it for a shorter detection delay.  Targets, checked by tools/lvk_sim -b on AC0 traces:
+//   false alarm, pack up to 10% low     under once per 10 hours of honking
+//   delay, pack low half the time       mean under 60mS, worst under 150mS
+//Measured on 320: no false alarm in 40 hours at 5, 10 or 15% low (63 an hour at 20%), delay
+//57.6mS mean and 112mS worst at 50% low, 20.5mS at 100%.
+#define LOW_VOLT_CUSUM_LOW			16
+#define LOW_VOLT_CUSUM_OK			5
+#ifndef LOW_VOLT_CUSUM_THRESHOLD
+#define LOW_VOLT_CUSUM_THRESHOLD	320
+#endif
+//ADC1 pack readings (every ~1mS) are added too, scored on how far below the low battery
+//level they are, less an allowance for ripple, and limited to what one AC0 sample could add
+#define LOW_VOLT_CUSUM_ADC_LEVEL	(LOW_VOLT_LOW_BATT_DAC_CNT << 4)	// 12 bit pack reading
+#define LOW_VOLT_CUSUM_ADC_ALLOW	8
+#define LOW_VOLT_CUSUM_ADC_MAX		LOW_VOLT_CUSUM_LOW
+
+//Analog front end power.  AC0 and DAC0, and the VREF they request, draw current whenever they
+//are enabled, so they only run continuously while the horn can load the pack: the boot check,
+//LOW_VOLT_STATE_CHECK_HORN1 (from the press, ahead of the BELL_DEBOUNCE_T commit) and any time
+//Horn_IsDriving().  Otherwise they are off and the RTC PIT (1 second) wakes
+//a single parked sample.
+//Settling: VREF start up, DAC0 settling and AC0 start up together are tens of uS worst case
+//(datasheet electrical characteristics).  After power up the AC0 state is not used until
+//LOW_VOLT_AFE_SETTLE_MS ticks have passed; 2 ticks guarantees at least one whole 977uS tick
+//whatever the phase of the power up in the first one, ~30x margin.  A honk never starts inside
+//that window since power up happens on the press and the horn waits out BELL_DEBOUNCE_T, and
+//the ADC1 pack readings keep feeding the detector through it.
+#define LOW_VOLT_AFE_SETTLE_MS		2
+//a parked sample is an unloaded pack, so a low one is strong evidence: 4 in a row flag low
+//battery, a good one takes off a quarter of that.  The parked AC0 sample and a rested cell
+//below CELL_REST_LOW_MV are each scored at most once a PIT period, so a warning from rest
+//takes 4 seconds on one of them alone, 2 with both low
+#define LOW_VOLT_CUSUM_REST_LOW		(LOW_VOLT_CUSUM_THRESHOLD / 4)
+#define LOW_VOLT_CUSUM_REST_OK		(LOW_VOLT_CUSUM_THRESHOLD / 16)
 
 
 typedef enum {
@@ -50,6 +103,14 @@ typedef enum {
 //Prototypes
 void LowVoltKill_init(void);
 void LowVoltKill_update(void);
+void LowVoltKill_analogPower(uint8_t On);
+void LowVoltKill_event(const Event *Ev);
+uint8_t LowVoltKill_isDead(void);
+void LowVoltKill_checkpoint(ResumeCheckpoint *Checkpoint);
+void LowVoltKill_resume(const ResumeCheckpoint *Checkpoint);
+void LowVoltKill_checkBellMiniBell(void);
+void LowVoltKill_releaseMiniBell(void);
+void LowVoltKill_checkBellMini(void);
 
 // External variable declarations
 extern uint16_t MiniHonkTimer_mS;
@@ -0,0 +1,186 @@
+/*****************************************************************************************
+**
+**  Profile.c
+**
+**  Behaviour Profiles for Tiny1616
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#include <avr/io.h>
+#include "Profile.h"
+#include "LowVoltKill.h"
+#include "Switch.h"
+#include "Timer.h"
+#include "Led.h"
+#include "Resume.h"
+#include "Config.h"
+
+//Power up gesture, followed from the main loop
+typedef enum {
+	PROFILE_GESTURE_OFF,	// 0 not looking for it, or it is over
+	PROFILE_GESTURE_WAIT,	// 1 power on, waiting for the ladder's first readings
+	PROFILE_GESTURE_HELD,	// 2 PROFILE_BUTTON down from power up
+	PROFILE_GESTURE_STORE,	// 3 switched, the USERROW write waits for the NVM
+	PROFILE_GESTURE_DONE	// 4 stored, green LED on until the button is let go
+} ProfileGesture;
+
+const Profile Profiles[PROFILE_COUNT] =
+{
+	[PROFILE_MINIBELL]	= { LowVoltKill_checkBellMiniBell, LowVoltKill_releaseMiniBell, 0,
+							{ HORN_SOFT_START_MS, HORN_HOLD_MS, HORN_SUSTAIN_DUTY } },
+	[PROFILE_MINI]		= { LowVoltKill_checkBellMini, 0, MINI_HONK_EXTENSION_TIME,
+							{ HORN_SOFT_START_MS, HORN_HOLD_MS, HORN_SUSTAIN_DUTY } },
+};
+
+const Profile *ProfileActive = &Profiles[CONFIG_MODE];
+
+uint8_t ProfileIndex;				// ProfileId running
+uint8_t ProfileGestureState;		// ProfileGesture
+uint16_t ProfileBootTick;			// RTC tick Profile_Init() ran on
+
+//local Functions
+static void Profile_Bind(uint8_t Index);
+static void Profile_Store(uint8_t Index);
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Profile_Init()
+//* Object              : bind the profile from USERROW0 and arm the power up gesture, after
+//*                       Resume_Init() and RTC_init(), before LowVoltKill_init().  Nothing
+//*                       here waits, the gesture is followed by Profile_Update()
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Profile_Init(void)
+{
+	uint8_t Index = PROFILE_USERROW;
+
+	if(Index >= PROFILE_COUNT)
+	{
+		Index = CONFIG_MODE;
+	}
+
+	Profile_Bind(Index);
+
+	ProfileBootTick = RTC_getTick();
+	ProfileGestureState = PROFILE_GESTURE_OFF;
+
+#if SWITCH_LADDER_FITTED
+	if(Resume_ResetFlags() & RSTCTRL_PORF_bm)
+	{
+		ProfileGestureState = PROFILE_GESTURE_WAIT;
+	}
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Profile_Update()
+//* Object              : follow the power up gesture from the main loop, every tick when
+//*                       not charging.  PROFILE_BUTTON down by PROFILE_GESTURE_START_MS and
+//*                       still down at PROFILE_GESTURE_MS steps to the next profile
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Profile_Update(void)
+{
+#if SWITCH_LADDER_FITTED
+	uint8_t Held;
+
+	if(ProfileGestureState == PROFILE_GESTURE_OFF)
+	{
+		return;
+	}
+
+	Held = SwitchButtonGetStatus(PROFILE_BUTTON);
+
+	switch(ProfileGestureState)
+	{
+		case PROFILE_GESTURE_WAIT:
+		{
+			if(Held)
+			{
+				ProfileGestureState = PROFILE_GESTURE_HELD;
+			}
+			else if(RTC_elapsedMS(ProfileBootTick) >= PROFILE_GESTURE_START_MS)
+			{
+				ProfileGestureState = PROFILE_GESTURE_OFF;
+			}
+			break;
+		}
+
+		case PROFILE_GESTURE_HELD:
+		{
+			if(!Held)
+			{
+				ProfileGestureState = PROFILE_GESTURE_OFF;
+			}
+			else if(RTC_elapsedMS(ProfileBootTick) >= PROFILE_GESTURE_MS)
+			{
+				Profile_Bind((ProfileIndex + 1 < PROFILE_COUNT) ? ProfileIndex + 1 : 0);
+				LED_Green(1);
+				ProfileGestureState = PROFILE_GESTURE_STORE;
+			}
+			break;
+		}
+
+		// like Energy_SaveByte(), an NVM write already going is left to finish for a tick
+		case PROFILE_GESTURE_STORE:
+		{
+			if(!(NVMCTRL.STATUS & NVMCTRL_EEBUSY_bm))
+			{
+				Profile_Store(ProfileIndex);
+				ProfileGestureState = PROFILE_GESTURE_DONE;
+			}
+			break;
+		}
+
+		default:
+		{
+			if(!Held)
+			{
+				LED_Green(0);
+				ProfileGestureState = PROFILE_GESTURE_OFF;
+			}
+			break;
+		}
+	}
+#endif
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Profile_Bind()
+//* Object              : make a profile the running one.  LowVoltKill.c reads it through
+//*                       ProfileActive, the horn drive is copied in
+//* Input Parameters    : uint8_t Index = ProfileId
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Profile_Bind(uint8_t Index)
+{
+	ProfileIndex = Index;
+	ProfileActive = &Profiles[Index];
+
+	Horn_SetDriveProfile(ProfileActive->Drive.RampTime_mS, ProfileActive->Drive.HoldTime_mS,
+						 ProfileActive->Drive.SustainDuty);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Profile_Store()
+//* Object              : write the profile index to USERROW0, like an EEPROM byte: into the
+//*                       page buffer, then erase and write the page.  Only with the NVM idle
+//* Input Parameters    : uint8_t Index = ProfileId
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Profile_Store(uint8_t Index)
+{
+	PROFILE_USERROW = Index;
+	_PROTECTED_WRITE_SPM(NVMCTRL.CTRLA, NVMCTRL_CMD_PAGEERASEWRITE_gc);
+}
@@ -0,0 +1,53 @@
+/*****************************************************************************************
+**
+**  Profile.h
+**
+**  Behaviour Profiles for Tiny1616
+**  one image carries every profile as a constant descriptor, the one to run is picked at
+**  boot and bound through one pointer, so the state machine has no per tick mode checks
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <avr/io.h>
+#include "Horn.h"
+
+//Selection.  USERROW0 holds the profile index, blank (0xFF) or out of range runs CONFIG_MODE.
+//Holding ladder button PROFILE_BUTTON from power up for PROFILE_GESTURE_MS steps to the next
+//profile, switches to it and stores it, the green LED stays on until the button is let go.
+//The horn switch plays no part, a honk from power up starts as it always has and nothing
+//waits for the gesture: Profile_Update() follows it from the main loop off the ladder's
+//debounced button status.  The button has to be down by PROFILE_GESTURE_START_MS, a later
+//press is an ordinary button press.  Only a power on reset with the ladder fitted looks for it.
+//USERROW survives a chip erase, so a bootloader update keeps the rider's choice.
+#define PROFILE_USERROW			USERROW.USERROW0
+#define PROFILE_BUTTON			0
+#define PROFILE_GESTURE_START_MS	50
+#define PROFILE_GESTURE_MS		1000
+
+typedef enum {
+	PROFILE_MINIBELL,	// 0 CONFIG_MODE_MINIBELL, bell rings after the horn is let go
+	PROFILE_MINI,		// 1 CONFIG_MODE_MINI, short honk extension instead of the bell
+	PROFILE_COUNT		// 2
+} ProfileId;
+
+typedef struct
+{
+	void (*CheckBell)(void);	// LOW_VOLT_STATE_CHECK_BELL
+	void (*Release)(void);		// horn let go in LOW_VOLT_STATE_CHECK_HORN1, 0 = nothing more
+	uint16_t MiniHonk_mS;		// honk extension after the release
+	HornDriveProfile Drive;		// HORN_ON soft start, hold and sustain
+} Profile;
+
+//Prototypes
+void Profile_Init(void);
+void Profile_Update(void);
+
+// External variable declarations
+extern const Profile *ProfileActive;
+
+#endif /* PROFILE_H */
@@ -0,0 +1,187 @@
+/*****************************************************************************************
+**
+**  Resume.c
+**
+**  Warm reset resume for Tiny1616
+**  checkpoint every tick from the main loop and again from the BOD VLM interrupt
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include "Resume.h"
+#include "LowVoltKill.h"
+#include "Timer.h"
+#include "Diag.h"
+
+//kept through every reset but power on, only trusted with a good CRC
+ResumeCheckpoint ResumeData __attribute__((section(".noinit")));
+
+uint8_t ResumeResetFlags;
+volatile uint8_t ResumeBusy;		// main loop is part way through a checkpoint
+uint8_t ResumeCount;				// watchdog and brown-out resumes in a row, saved with the checkpoint
+uint16_t ResumeBootTick;			// RTC tick Resume_Check() ran on
+
+//local Functions
+static uint16_t Resume_Crc(const ResumeCheckpoint *Checkpoint);
+static void Resume_Write(void);
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Resume_Crc()
+//* Object              : CRC16 CCITT of a checkpoint, not counting the Crc field
+//* Input Parameters    : const ResumeCheckpoint *Checkpoint
+//* Output Parameters   : uint16_t = CRC
+//*--------------------------------------------------------------------------------------
+
+static uint16_t Resume_Crc(const ResumeCheckpoint *Checkpoint)
+{
+	const uint8_t *p = (const uint8_t *)Checkpoint;
+	uint16_t Crc = 0xFFFF;
+
+	for(uint8_t i = 0; i < sizeof(ResumeCheckpoint) - sizeof(Checkpoint->Crc); i++)
+	{
+		Crc = _crc_ccitt_update(Crc, p[i]);
+	}
+
+	return Crc;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Resume_Init()
+//* Object              : read and clear the reset cause, arm the VLM interrupt.  Call first
+//*                       thing in main()
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Resume_Init(void)
+{
+	ResumeResetFlags = RSTCTRL.RSTFR;
+	RSTCTRL.RSTFR = ResumeResetFlags;
+
+	BOD.VLMCTRLA = RESUME_VLM_LEVEL;
+	BOD.INTFLAGS = BOD_VLMIF_bm;
+	BOD.INTCTRL = BOD_VLMCFG_BELOW_gc | BOD_VLMIE_bm;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Resume_Check()
+//* Object              : is this a warm reset with a good checkpoint to resume from.  The
+//*                       checkpoint is spoiled after it is read so it is only used once.  A
+//*                       reset past RESUME_MAX resumes in a row cold starts instead
+//* Input Parameters    : ResumeCheckpoint *Checkpoint = copy of the checkpoint if so
+//* Output Parameters   : uint8_t = 1 to resume, 0 to cold start
+//*--------------------------------------------------------------------------------------
+
+uint8_t Resume_Check(ResumeCheckpoint *Checkpoint)
+{
+	uint8_t Resume = 0;
+
+	ResumeCount = 0;
+	ResumeBootTick = RTC_getTick();
+
+	if((ResumeResetFlags & RESUME_RESET_FLAGS) && !(ResumeResetFlags & RSTCTRL_PORF_bm))
+	{
+		if(ResumeData.Crc == Resume_Crc(&ResumeData))
+		{
+			ResumeCount = ResumeData.Resumes;
+
+			if(ResumeCount < RESUME_MAX)
+			{
+				ResumeCount++;
+				Resume = 1;
+			}
+			else
+			{
+				// hung or browned out again every time it resumed, start clean
+				ResumeCount = 0;
+			}
+
+			if(Resume)
+			{
+				*Checkpoint = ResumeData;
+			}
+		}
+	}
+
+	ResumeData.Crc = ~Resume_Crc(&ResumeData);
+
+	return Resume;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Resume_ResetFlags()
+//* Object              : what caused this reset, as Resume_Init() found it
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = RSTCTRL.RSTFR bits
+//*--------------------------------------------------------------------------------------
+
+uint8_t Resume_ResetFlags(void)
+{
+	return ResumeResetFlags;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Resume_Write()
+//* Object              : fill in the checkpoint and its CRC
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Resume_Write(void)
+{
+	LowVoltKill_checkpoint(&ResumeData);
+	ResumeData.Resumes = ResumeCount;
+	ResumeData.Crc = Resume_Crc(&ResumeData);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Resume_Save()
+//* Object              : checkpoint from the main loop, once a tick.  This is what a
+//*                       watchdog reset, which gives no warning, resumes from.  Running
+//*                       RESUME_CLEAR_MS clears the resume count
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Resume_Save(void)
+{
+	if(ResumeCount && RTC_elapsedMS(ResumeBootTick) >= RESUME_CLEAR_MS)
+	{
+		ResumeCount = 0;
+	}
+
+	ResumeBusy = 1;
+	Resume_Write();
+	ResumeBusy = 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ISR(BOD_VLM_vect)
+//* Object              : supply about to brown out, checkpoint now.  If the main loop was
+//*                       part way through one it finishes it when this returns
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+ISR(BOD_VLM_vect)
+{
+	DIAG_ISR_ENTER();
+
+	BOD.INTFLAGS = BOD_VLMIF_bm;
+
+	if(!ResumeBusy)
+	{
+		Resume_Write();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*****************************************************************************************
+**
+**  Resume.h
+**
+**  Warm reset resume for Tiny1616
+**  the state machine is checkpointed to .noinit so a brown-out or watchdog reset mid honk
+**  picks up where it was instead of going through the power up checks again
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef RESUME_H
+#define RESUME_H
+
+#include <avr/io.h>
+
+//BOD voltage level monitor, interrupt when VDD falls to 5% above the BODLEVEL7 trip
+//(4.3V -> ~4.5V), the last chance to checkpoint before the brown-out reset
+#define RESUME_VLM_LEVEL		BOD_VLMLVL_5ABOVE_gc
+
+//Resets that resume.  Power on, UPDI and external resets always cold start
+#define RESUME_RESET_FLAGS		(RSTCTRL_BORF_bm | RSTCTRL_WDRF_bm)
+
+//A hang that comes back with the resumed state would resume forever, the checkpoint is fresh
+//every tick.  So would a brown-out in a driving state, the resumed horn loads the pack
+//straight back down without the boot kill check.  After RESUME_MAX resumes in a row, of
+//either kind, the next reset cold starts.  The count clears once the loop has run
+//RESUME_CLEAR_MS without one
+#define RESUME_MAX				3
+#define RESUME_CLEAR_MS			5000
+
+typedef struct
+{
+	uint8_t State;					// LowVoltState
+	uint8_t BellState;
+	uint8_t Sound;					// sound owning the horn, HORN_OFF for none
+	uint8_t SwitchPressed;			// debounced horn switch
+	uint8_t Detected;				// LowVoltDetected
+	uint16_t Cusum;					// LowVoltCusum
+	uint16_t KillTimer_mS;			// LowVoltkillTimer_mS
+	uint16_t BellDebounceTimer_mS;
+	uint16_t MiniHonkTimer_mS;
+	uint8_t Resumes;				// watchdog and brown-out resumes in a row, filled in by Resume.c
+	uint16_t Crc;					// CRC16 CCITT of everything above
+} ResumeCheckpoint;
+
+//Prototypes
+void Resume_Init(void);
+uint8_t Resume_Check(ResumeCheckpoint *Checkpoint);
+uint8_t Resume_ResetFlags(void);
+void Resume_Save(void);
+
+#endif /* RESUME_H */
\ No newline at end of file
@@ -0,0 +1,211 @@
+/*****************************************************************************************
+**
+**  Sag.c
+**
+**  Pack sag capture for Tiny1616
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "Sag.h"
+#include "Horn.h"
+#include "Event.h"
+#include "Diag.h"
+#include "Snapshot.h"
+
+//Written by the TCB0 ISR, published on SagSeq.  The main loop only fills in SinceHorn_mS
+volatile SagRecord SagRing[SAG_RING_SIZE];
+volatile uint8_t SagHead;			// next slot to fill
+volatile uint16_t SagCount;
+volatile uint16_t SagWidthMax;
+volatile uint16_t SagRipple;
+SnapshotSeq SagSeq;
+
+volatile uint8_t SagHighTick;		// EventTicks the main loop last saw AC0 high, settled
+volatile uint8_t SagOpen;			// AC0 has read high settled, the capture is real
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sag_Init()
+//* Object              : route AC0's output to TCB0 and start the pulse width capture, AC0
+//*                       itself is set up and powered by LowVoltKill.c
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Sag_Init(void)
+{
+	EVSYS.ASYNCCH0 = SAG_EVENT_GEN;
+	EVSYS.ASYNCUSER0 = EVSYS_ASYNCUSER0_ASYNCCH0_gc;	// TCB0
+
+	TCB0.CTRLB = TCB_CNTMODE_PW_gc;
+	TCB0.EVCTRL = TCB_CAPTEI_bm | TCB_EDGE_bm;
+	TCB0.INTFLAGS = TCB_CAPT_bm;
+	TCB0.INTCTRL = TCB_CAPT_bm;
+	TCB0.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ISR(TCB0_INT_vect)
+//* Object              : the pack is back above DAC0, time the sag and log it.  Up to
+//*                       SAG_EXACT_TICKS since AC0 was last seen high the count can not have
+//*                       wrapped, past that the ticks time it to within one.  A sag over
+//*                       250mS wraps EventTicks and reads short, the 1mS AC0 samples in
+//*                       LowVoltKill.c have long since acted on one that long
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+ISR(TCB0_INT_vect)
+{
+	DIAG_ISR_ENTER();
+
+	uint16_t Counts = TCB0.CCMP;		// reading it clears CAPT
+	uint8_t Ticks = EventTicks - SagHighTick;
+	uint16_t Width;
+
+	if(SagOpen)
+	{
+		if(Ticks <= SAG_EXACT_TICKS)
+		{
+			Width = Counts / SAG_COUNTS_PER_US;
+		}
+		else if(Ticks >= 0xFFFF / SAG_TICK_US)
+		{
+			Width = 0xFFFF;
+		}
+		else
+		{
+			Width = Ticks * SAG_TICK_US;
+		}
+
+		if(Width < SAG_MIN_US)
+		{
+			if(SagRipple < 0xFFFF)
+			{
+				SagRipple++;
+			}
+		}
+		else
+		{
+			uint8_t Slot = SagHead & SAG_RING_MASK;
+
+			SagRing[Slot].Width_uS = Width;
+			SagRing[Slot].SinceHorn_mS = SAG_NOT_HONKING;
+			SagRing[Slot].Level = DAC0.DATA;
+			SagHead++;
+
+			if(SagCount < 0xFFFF)
+			{
+				SagCount++;
+			}
+			if(Width > SagWidthMax)
+			{
+				SagWidthMax = Width;
+			}
+
+			Event_Post(EVENT_SAG, Slot);
+		}
+
+		SNAPSHOT_PUBLISH(SagSeq);
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sag_Event()
+//* Object              : EVENT_SAG from the main loop, place the sag in the honk.  The
+//*                       event waited (now - Stamp) ticks and the sag started Width before
+//*                       it was posted
+//* Input Parameters    : const Event *Ev = EVENT_SAG, Data = ring slot
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Sag_Event(const Event *Ev)
+{
+	uint16_t Honk_mS = Horn_HonkTime();
+	uint16_t Width;
+
+	if(Honk_mS == SAG_NOT_HONKING)
+	{
+		return;
+	}
+
+	SNAPSHOT_READ(SagSeq, Width, SagRing[Ev->Data].Width_uS);
+
+	uint16_t Ago_mS = (uint8_t)(EventTicks - Ev->Stamp) + Width / 1000;
+
+	SagRing[Ev->Data].SinceHorn_mS = (Honk_mS > Ago_mS) ? Honk_mS - Ago_mS : 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sag_Read()
+//* Object              : copy one of the logged sags, Snapshot.h retry with the slot worked
+//*                       out inside the loop so a new sag can not shift the age under it
+//* Input Parameters    : uint8_t Age = 0 newest, up to SAG_RING_SIZE - 1
+//*                       SagRecord *Record = where to put it
+//* Output Parameters   : uint8_t = 1 if there is a sag that old
+//*--------------------------------------------------------------------------------------
+
+uint8_t Sag_Read(uint8_t Age, SagRecord *Record)
+{
+	uint8_t Start;
+	uint8_t Found;
+
+	do
+	{
+		Start = SagSeq;
+		Found = (Age < SAG_RING_SIZE && Age < SagCount);
+
+		if(Found)
+		{
+			*Record = SagRing[(uint8_t)(SagHead - 1 - Age) & SAG_RING_MASK];
+		}
+	} while (Start != SagSeq);
+
+	return Found;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sag_Stat()
+//* Object              : sag capture figures for Diag_Read()
+//* Input Parameters    : uint8_t Which = SagStat
+//* Output Parameters   : uint32_t = value, 0 for an unknown Which
+//*--------------------------------------------------------------------------------------
+
+uint32_t Sag_Stat(uint8_t Which)
+{
+	uint16_t Value;
+
+	switch (Which)
+	{
+		case SAG_STAT_COUNT:
+		{
+			SNAPSHOT_READ(SagSeq, Value, SagCount);
+			return Value;
+		}
+
+		case SAG_STAT_WIDTH_MAX:
+		{
+			SNAPSHOT_READ(SagSeq, Value, SagWidthMax);
+			return Value;
+		}
+
+		case SAG_STAT_RIPPLE:
+		{
+			SNAPSHOT_READ(SagSeq, Value, SagRipple);
+			return Value;
+		}
+
+		default:
+		{
+			return 0;
+		}
+	}
+}
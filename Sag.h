@@ -0,0 +1,76 @@
+/*****************************************************************************************
+**
+**  Sag.h
+**
+**  Pack sag capture for Tiny1616
+**  AC0's output reaches TCB0 through EVSYS, TCB0 times every excursion below the DAC0 level
+**  in hardware and its capture interrupt logs the ones that matter
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef SAG_H
+#define SAG_H
+
+#include <avr/io.h>
+#include "Event.h"
+
+//Capture.  TCB0 in pulse width mode on the AC0 output, EDGE set so the falling edge (pack
+//going below DAC0) clears and starts the count and the rising edge captures it.  TCB0 runs
+//on CLK_PER / 2, F_CPU is CLK_PER (main.c checks it against the fuse and prescaler), so
+//0.25uS a count and the 16 bit count covers 16.4mS; anything that could have wrapped is
+//timed from the tick instead, SAG_TICK_US a tick, from the last tick the main loop saw AC0
+//high.  AC0 has no interrupt of its own, hysteresis keeps carrier chatter off its output.
+//While charging CLK_PER is the 32kHz oscillator and AC0 is off, nothing is captured.
+#define SAG_EVENT_GEN		EVSYS_ASYNCCH0_AC0_OUT_gc
+#define SAG_TCB_CLOCK		(F_CPU / 2)									// TCB_CLKSEL_CLKDIV2_gc
+#define SAG_COUNTS_PER_US	(SAG_TCB_CLOCK / 1000000UL)					// 4
+#define SAG_TICK_US			977											// 1024Hz tick
+#define SAG_EXACT_TICKS		((0x10000UL / SAG_COUNTS_PER_US) / SAG_TICK_US - 1)	// 15, < 15.6mS, can not have wrapped
+
+#if (SAG_TCB_CLOCK % 1000000UL) || SAG_COUNTS_PER_US == 0
+#error "Sag.c needs TCB0 at a whole number of counts per uS"
+#endif
+
+//A sag is logged and posted as EVENT_SAG when it lasts at least SAG_MIN_US.  HORN_ON ripple
+//troughs at the 20kHz carrier are shorter than one 50uS period, so this keeps them out of the
+//log and the low battery detector; they are only counted
+#define SAG_MIN_US			60
+
+//Ring of the last sags, a power of 2
+#define SAG_RING_SIZE		8
+#define SAG_RING_MASK		(SAG_RING_SIZE - 1)
+
+#define SAG_NOT_HONKING		0xFFFF		// SinceHorn_mS for a sag outside HORN_ON
+
+typedef struct
+{
+	uint16_t Width_uS;		// time below the DAC0 level, saturates at 65535
+	uint16_t SinceHorn_mS;	// HORN_ON start to the start of the sag, or SAG_NOT_HONKING
+	uint8_t Level;			// DAC0.DATA it went below, kill or low battery level
+} SagRecord;
+
+//Sag_Stat() values
+typedef enum {
+	SAG_STAT_COUNT,			// 0 sags logged since reset
+	SAG_STAT_WIDTH_MAX,		// 1 longest sag, uS
+	SAG_STAT_RIPPLE			// 2 excursions shorter than SAG_MIN_US
+} SagStat;
+
+//Main loop, each tick AC0 is settled and reads high: captures are real from here on, and a
+//sag is at least as old as this tick
+#define SAG_HIGH()			do { SagHighTick = EventTicks; SagOpen = 1; } while (0)
+//AC0 going off, its output drops and would look like a sag
+#define SAG_CLOSE()			do { SagOpen = 0; } while (0)
+
+extern volatile uint8_t SagHighTick;
+extern volatile uint8_t SagOpen;
+
+//Prototypes
+void Sag_Init(void);
+void Sag_Event(const Event *Ev);
+uint8_t Sag_Read(uint8_t Age, SagRecord *Record);
+uint32_t Sag_Stat(uint8_t Which);
+
+#endif /* SAG_H */
@@ -0,0 +1,50 @@
+/*****************************************************************************************
+**
+**  Snapshot.h
+**
+**  Consistent reads of multi byte data an ISR writes, for Tiny1616
+**  a sequence count per ISR instead of cli / sei around every read in the main loop
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <avr/io.h>
+
+//The ISR writes its fields then SNAPSHOT_PUBLISH()es.  A reader copies the fields and copies
+//again if the count moved while it did.  One core and no nested writers: the ISR always runs
+//to the end before the main loop carries on, so a reader sees either a whole update or a
+//changed count, never half of one, and interrupts are never held off.  A retry costs one more
+//copy and needs a second interrupt inside a few cycles window to happen again.
+//Single byte fields are atomic already and do not need this.  tools/snapshot_test checks the
+//retry on the host, a signal handler standing in for the ISR.
+typedef volatile uint8_t SnapshotSeq;
+
+#define SNAPSHOT_PUBLISH(seq)			((seq)++)
+
+#define SNAPSHOT_READ(seq, dst, src)	do { (void)sizeof(char[(sizeof(dst) == sizeof(src)) ? 1 : -1]); \
+											Snapshot_Read(&(seq), &(dst), &(src), sizeof(dst)); } while (0)
+
+//*--------------------------------------------------------------------------------------
+//* Snapshot_Read(), only called through SNAPSHOT_READ() so Size matches both sides
+//*--------------------------------------------------------------------------------------
+
+static inline void Snapshot_Read(const SnapshotSeq *Seq, void *Dst, const volatile void *Src, uint8_t Size)
+{
+	uint8_t Start;
+
+	do
+	{
+		Start = *Seq;
+
+		for (uint8_t i = 0; i < Size; i++)
+		{
+			((uint8_t *)Dst)[i] = ((const volatile uint8_t *)Src)[i];
+		}
+	} while (Start != *Seq);
+}
+
+#endif /* SNAPSHOT_H */
\ No newline at end of file
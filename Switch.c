@@ -11,12 +11,35 @@
 #include <avr/io.h>
 #include "Timer.h"
 #include "Switch.h"
+#include "Gpio.h"
+#include "Event.h"
+#include "Diag.h"
+#include <avr/interrupt.h>
 
 //global variables
 uint16_t SwitchOldTick;
 uint8_t SwitchHornDebounce;
 uint8_t SwitchHornStatus;
 
+//Button ladder, written from the ADC0 ISR, all single bytes
+typedef struct
+{
+	uint16_t Min;
+	uint16_t Max;
+} SwitchWindow;
+
+const SwitchWindow SwitchLadderWindows[SWITCH_LADDER_BUTTONS] =
+{
+	{    0,  180 },
+	{  270,  540 },
+	{  600, 1000 },
+};
+
+uint8_t SwitchLadderCount;										// readings on the pending button, or off the button down
+uint8_t SwitchLadderPending = SWITCH_LADDER_NONE;				// window the last reading was in, nothing down
+uint8_t SwitchLadderButton = SWITCH_LADDER_NONE;				// debounced button down
+volatile uint8_t SwitchButtonStatus[SWITCH_LADDER_BUTTONS];	// like SwitchHornStatus, per button
+
 
 //*--------------------------------------------------------------------------------------
 //* Function Name       : SwitchInit()
@@ -28,12 +51,12 @@ uint8_t SwitchHornStatus;
 void SwitchInit(void)
 {
 	//Configure ID Pins
-	SWITCH_HORN_PORT.DIRCLR = SWITCH_HORN_BIT;
-	SWITCH_HORN_PORT.OUTSET = SWITCH_HORN_BIT;
-	SWITCH_HORN_CTRL = PORT_PULLUPEN_bm;
+	GPIO_INPUT(SWITCH_HORN);
+	GPIO_SET(SWITCH_HORN);
+	SWITCH_HORN_CTRL = PORT_PULLUPEN_bm | PORT_ISC_BOTHEDGES_gc;
 
 	//Initialize variables used for Horn Switch
-	SwitchOldTick = 0;
+	SwitchOldTick = RTC_getTick();
 	SwitchHornDebounce = SWITCH_HORN_DEBOUNCE_INITIAL; // was zero before
 	SwitchHornStatus = 0;
 }
@@ -48,16 +71,23 @@ void SwitchInit(void)
 
 void SwitchUpdate(void)
 {
-	//check if time to scan switches
-	if(RTC_getTick() != SwitchOldTick)
+	//one debounce step per tick since the last scan, a late pass takes the pin as held
+	uint16_t Ticks = RTC_tickUpdate(&SwitchOldTick);
+
+	if(Ticks > 255)
 	{
-		SwitchOldTick = RTC_getTick();
+		Ticks = 255;
+	}
+
+	uint8_t Pressed = !GPIO_READ(SWITCH_HORN);
 
+	while(Ticks--)
+	{
 		//***********************************
 		// Horn Switch
 		//***********************************
 		//is switch pressed?
-		if(!(SWITCH_HORN_PORT.IN & SWITCH_HORN_BIT))
+		if(Pressed)
 		{
 			if(SwitchHornDebounce < 255)
 			{
@@ -86,6 +116,131 @@ void SwitchUpdate(void)
 }
 
 
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ISR(PORTB_PORT_vect)
+//* Object              : horn switch edge, post it and let SwitchUpdate() debounce
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+ISR(PORTB_PORT_vect)
+{
+	DIAG_ISR_ENTER();
+
+	uint8_t Flags = VPORTB.INTFLAGS;
+	VPORTB.INTFLAGS = Flags;
+
+	if(Flags & SWITCH_HORN_BIT)
+	{
+		Event_Post(EVENT_SWITCH, GPIO_READ(SWITCH_HORN));
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : SwitchLadderSample()
+//* Object              : class one EXT_IN reading and debounce the press and the release,
+//*                       from the ADC0 ISR
+//* Input Parameters    : uint16_t Reading = 12 bit EXT_IN reading
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void SwitchLadderSample(uint16_t Reading)
+{
+	uint8_t Class = SWITCH_LADDER_NONE;
+
+	if(Reading >= SWITCH_LADDER_IDLE_MIN)
+	{
+		Class = SWITCH_LADDER_BUTTONS;		// idle
+	}
+	else
+	{
+		for(uint8_t i = 0; i < SWITCH_LADDER_BUTTONS; i++)
+		{
+			if(Reading >= SwitchLadderWindows[i].Min && Reading <= SwitchLadderWindows[i].Max)
+			{
+				Class = i;
+				break;
+			}
+		}
+	}
+
+	// nothing down, SWITCH_LADDER_PRESS readings in a row inside the same window is a press
+	if(SwitchLadderButton == SWITCH_LADDER_NONE)
+	{
+		if(Class >= SWITCH_LADDER_BUTTONS)
+		{
+			SwitchLadderPending = SWITCH_LADDER_NONE;
+			return;
+		}
+
+		if(Class != SwitchLadderPending)
+		{
+			SwitchLadderPending = Class;
+			SwitchLadderCount = 0;
+		}
+
+		if(++SwitchLadderCount < SWITCH_LADDER_PRESS)
+		{
+			return;
+		}
+
+		SwitchLadderPending = SWITCH_LADDER_NONE;
+		SwitchLadderButton = Class;
+		SwitchLadderCount = 0;
+		SwitchButtonStatus[Class] = 1;
+		Event_Post(EVENT_BUTTON, Class | EVENT_BUTTON_PRESSED);
+		return;
+	}
+
+	// a button is down, idle, between windows or another button all count towards the release
+	if(Class == SwitchLadderButton)
+	{
+		SwitchLadderCount = 0;
+		return;
+	}
+
+	if(++SwitchLadderCount < SWITCH_LADDER_RELEASE)
+	{
+		return;
+	}
+
+	// off it long enough, the next reading in a window is the next press
+	SwitchButtonStatus[SwitchLadderButton] = 0;
+	Event_Post(EVENT_BUTTON, SwitchLadderButton);
+	SwitchLadderButton = SWITCH_LADDER_NONE;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : SwitchButtonGetStatus()
+//* Object              : return the status of a ladder button, as SwitchHornGetStatus()
+//* Input Parameters    : uint8_t Button = 0 to SWITCH_LADDER_BUTTONS - 1
+//* Output Parameters   : uint8_t = button Status
+//*--------------------------------------------------------------------------------------
+
+uint8_t SwitchButtonGetStatus(uint8_t Button)
+{
+	return (Button < SWITCH_LADDER_BUTTONS) ? SwitchButtonStatus[Button] : 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : SwitchClearButtonStatus()
+//* Object              : clear a ladder button, as SwitchClearHornStatus()
+//* Input Parameters    : uint8_t Button = 0 to SWITCH_LADDER_BUTTONS - 1
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void SwitchClearButtonStatus(uint8_t Button)
+{
+	if(Button < SWITCH_LADDER_BUTTONS)
+	{
+		SwitchButtonStatus[Button] = 0;
+	}
+}
+
+
 //*--------------------------------------------------------------------------------------
 //* Function Name       : SwitchHornGetStatus()
 //* Object              : return the status of the horn switch
@@ -99,6 +254,24 @@ uint8_t SwitchHornGetStatus(void)
 }
 
 
+//*--------------------------------------------------------------------------------------
+//* Function Name       : SwitchResume()
+//* Object              : warm reset, carry a debounced press over if the switch is still
+//*                       down instead of waiting TIME_SWITCH_PRESS_DET again
+//* Input Parameters    : uint8_t Pressed = debounced status before the reset
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void SwitchResume(uint8_t Pressed)
+{
+	if(Pressed && !GPIO_READ(SWITCH_HORN))
+	{
+		SwitchHornDebounce = 255;
+		SwitchHornStatus = 1;
+	}
+}
+
+
 //*--------------------------------------------------------------------------------------
 //* Function Name       : SwitchClearHornStatus()
 //* Object              : clear horn bit
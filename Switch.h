@@ -24,6 +24,29 @@
 #define SWITCH_HORN_BIT			(1 << SWITCH_HORN_PIN)
 #define SWITCH_HORN_CTRL		PORTB.PIN1CTRL
 
+//Button ladder on ADC_CHAN_EXT_IN (PA3).  10k pull-up to VDD, each button to GND through its
+//own resistor.  The ladder divides VDD, so EXT_IN is read against VDD as well and a reading
+//is the resistor ratio alone, the same at 4.3V as at 5.5V.  The 10k is the only pull-up,
+//PA3's internal one stays off.  Set SWITCH_LADDER_FITTED to 0 on a board without it:
+//   button 0   0R     0          -> 0
+//   button 1   1k0    1/11       -> ~372   (340-407 with 5% parts)
+//   button 2   2k2    2.2/12.2   -> ~738   (679-800 with 5% parts)
+//   idle              1          -> 4092
+//EXT_IN is read on every tick as one 10 bit sample straight after the ADC pair, see
+//ADC_ScanInput().  The node settles through the 10k in well under a microsecond, so a single
+//sample is the idle level or one button's level even while the contacts bounce, where an
+//accumulated read could average the two into another button's window.  A press is
+//SWITCH_LADDER_PRESS readings in a row inside the same window, one or two ticks (1-2mS),
+//so a reading caught mid edge or a bounce through another window is not a press.  The
+//release is the button reading off its window for SWITCH_LADDER_RELEASE readings in a row
+//(~6.8mS), bounce back onto it restarts the count
+#define SWITCH_LADDER_FITTED	1
+#define SWITCH_LADDER_BUTTONS	3
+#define SWITCH_LADDER_PRESS		2
+#define SWITCH_LADDER_RELEASE	7
+#define SWITCH_LADDER_IDLE_MIN	3950	// no button pressed, at or near full scale
+#define SWITCH_LADDER_NONE		0xFF	// no button / reading between windows
+
 //Switch macros
 //#define	SwitchPowerPressed()	(!(SwitchInputs & SWITCH_POWER))
 //#define	SwitchUser1Pressed()	(!(SwitchInputs & SWITCH_USER1))
@@ -34,5 +57,9 @@ void SwitchInit (void);
 void SwitchUpdate(void);
 uint8_t SwitchHornGetStatus(void);
 void SwitchClearHornStatus(void);
+void SwitchLadderSample(uint16_t Reading);
+uint8_t SwitchButtonGetStatus(uint8_t Button);
+void SwitchClearButtonStatus(uint8_t Button);
+void SwitchResume(uint8_t Pressed);
 
 #endif /* SWITCH_H */
\ No newline at end of file
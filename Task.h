@@ -0,0 +1,44 @@
+/*****************************************************************************************
+**
+**  Task.h
+**
+**  Stackless cooperative tasks for Tiny1616
+**  lets a sequence be written top to bottom without blocking the main loop, each task
+**  costs a Task struct (4 bytes) of RAM
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <avr/io.h>
+#include "Timer.h"
+
+//Task return values, a task function returns one of these every time it is called
+#define TASK_DONE		0
+#define TASK_WAITING	1
+
+typedef struct
+{
+	uint16_t Line;		// where to resume, 0 = from the top
+	uint16_t Tick;		// RTC tick the current TASK_DELAY started on
+} Task;
+
+//Task macros.  Rules inside a task body:
+//  - locals are not kept across TASK_YIELD / TASK_AWAIT / TASK_DELAY, keep state in globals
+//  - no switch statements, the resume points are case labels of the TASK_BEGIN switch
+#define TASK_INIT(t)			((t)->Line = 0)
+
+#define TASK_BEGIN(t)			switch ((t)->Line) { case 0:
+
+#define TASK_YIELD(t)			do { (t)->Line = __LINE__; return TASK_WAITING; case __LINE__: ; } while (0)
+
+#define TASK_AWAIT(t, cond)		do { (t)->Line = __LINE__; case __LINE__: if (!(cond)) return TASK_WAITING; } while (0)
+
+#define TASK_DELAY(t, ms)		do { (t)->Tick = RTC_getTick(); TASK_AWAIT(t, RTC_elapsedMS((t)->Tick) >= (uint16_t)(ms)); } while (0)
+
+#define TASK_END(t)				} (t)->Line = 0; return TASK_DONE
+
+#endif /* TASK_H */
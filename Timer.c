@@ -12,6 +12,10 @@
 #include <avr/interrupt.h>
 #include <avr/wdt.h>
 #include "Timer.h"
+#include "Diag.h"
+#include "Event.h"
+
+volatile uint8_t RTC_PitCount;		// PIT periods since reset, wraps, one byte so no Snapshot.h needed
 
 //*--------------------------------------------------------------------------------------
 //* Function Name       : RTC_init()
@@ -31,6 +35,128 @@ void RTC_init(void)
 }  
 
 
+//*--------------------------------------------------------------------------------------
+//* Function Name       : RTC_pitInit()
+//* Object              : Start the periodic interrupt timer.  Its divided clock is used as
+//*                       an event generator, the interrupt itself is left off
+//* Input Parameters    : uint8_t Period = RTC_PERIOD_xxx_gc interrupt period
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void RTC_pitInit(uint8_t Period)
+{
+	while (RTC.PITSTATUS > 0)
+	{
+		;										/* Wait for PITCTRLA to be synchronized */
+	}
+	RTC.PITCTRLA = Period | RTC_PITEN_bm;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : RTC_pitInterrupt()
+//* Object              : turn the PIT interrupt on or off, each period bumps RTC_PitCount
+//*                       and wakes the CPU from standby
+//* Input Parameters    : uint8_t Enable = 1 on, 0 off
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void RTC_pitInterrupt(uint8_t Enable)
+{
+	RTC.PITINTFLAGS = RTC_PI_bm;
+	RTC.PITINTCTRL = Enable ? RTC_PI_bm : 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : RTC_pitUpdate()
+//* Object              : check for a new PIT period since the caller last looked
+//* Input Parameters    : uint8_t *LastCount = caller's copy of RTC_PitCount, updated
+//* Output Parameters   : uint8_t = 1 if at least one period has passed
+//*--------------------------------------------------------------------------------------
+
+uint8_t RTC_pitUpdate(uint8_t *LastCount)
+{
+	uint8_t Count = RTC_PitCount;
+
+	if(Count == *LastCount)
+	{
+		return 0;
+	}
+
+	*LastCount = Count;
+	return 1;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ISR(RTC_PIT_vect)
+//* Object              : count PIT periods
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+ISR(RTC_PIT_vect)
+{
+	DIAG_ISR_ENTER();
+
+	RTC.PITINTFLAGS = RTC_PI_bm;
+	RTC_PitCount++;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Timer_tickInit()
+//* Object              : start the TCB1 periodic interrupt that posts EVENT_TICK.  The
+//*                       tick count itself stays RTC.CNT, no ISR touches the RTC 16 bit
+//*                       registers so main loop reads of it never lose their TEMP byte
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Timer_tickInit(void)
+{
+	TCB1.CCMP = TIMER_TICK_CCMP;
+	TCB1.CTRLB = TCB_CNTMODE_INT_gc;
+	TCB1.INTFLAGS = TCB_CAPT_bm;
+	TCB1.INTCTRL = TCB_CAPT_bm;
+	TCB1.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Timer_tickSlow()
+//* Object              : set the tick period for the clock that is about to run, call it
+//*                       right after switching CLK_PER.  TCB1 stays on, it also triggers
+//*                       the ADCs through EVSYS
+//* Input Parameters    : uint8_t Slow = 1 for the 32kHz charging clock, 0 for F_CPU
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+void Timer_tickSlow(uint8_t Slow)
+{
+	TCB1.CCMP = Slow ? TIMER_TICK_SLOW_CCMP : TIMER_TICK_CCMP;
+	TCB1.CNT = 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : ISR(TCB1_INT_vect)
+//* Object              : main loop tick
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+ISR(TCB1_INT_vect)
+{
+	DIAG_ISR_ENTER();
+
+	TCB1.INTFLAGS = TCB_CAPT_bm;
+	EventTicks++;
+	Event_Post(EVENT_TICK, 0);
+}
+
+
 //*--------------------------------------------------------------------------------------
 //* Function Name       : RTC_getTick()
 //* Object              : Return The current system timer Tick value
@@ -45,25 +171,33 @@ inline uint16_t RTC_getTick(void)
 
 
 //*--------------------------------------------------------------------------------------
-//* Function Name       : RTC_delayMS()
-//* Object              : Delay number of mS passed in
-//* Input Parameters    : unsigned int DelayValue = delay to wait x 1mS
-//* Output Parameters   : none
+//* Function Name       : RTC_tickUpdate()
+//* Object              : RTC ticks since the caller last looked, each user keeps its own
+//*                       tick like RTC_pitUpdate().  Per tick work steps its timers by the
+//*                       result so a late pass, or two passes in one tick, keep real time
+//* Input Parameters    : uint16_t *LastTick = caller's copy of RTC_getTick(), updated
+//* Output Parameters   : uint16_t = ticks passed, 0 if still the same tick
 //*--------------------------------------------------------------------------------------
 
-void RTC_delayMS(uint16_t DelayValue)
+uint16_t RTC_tickUpdate(uint16_t *LastTick)
 {
-   uint16_t oldtick;
-
-   oldtick = RTC_getTick();
-
-   while(DelayValue != 0)
-   {
-      if(RTC_getTick() != oldtick)
-      {
-         oldtick = RTC_getTick();
-         DelayValue--;
-         wdt_reset();
-      }
-   }
+	uint16_t Tick = RTC_getTick();
+	uint16_t Ticks = Tick - *LastTick;
+
+	*LastTick = Tick;
+	return Ticks;
 }
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : RTC_elapsedMS()
+//* Object              : mS passed since a tick taken with RTC_getTick(), wrap safe
+//*                       use with Task.h TASK_DELAY instead of blocking for a delay
+//* Input Parameters    : uint16_t since = earlier RTC_getTick() value
+//* Output Parameters   : uint16_t = mS elapsed
+//*--------------------------------------------------------------------------------------
+
+uint16_t RTC_elapsedMS(uint16_t since)
+{
+	return RTC_getTick() - since;
+}
\ No newline at end of file
@@ -11,10 +11,36 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+//Main loop tick.  TCB1 posts EVENT_TICK at about the RTC tick rate, 1024Hz, to wake the main
+//loop.  It runs off CLK_PER (F_CPU, 16MHz / 2), so on the 32kHz charging clock Timer_tickSlow()
+//reloads it for TIMER_TICK_SLOW_HZ, 1024 CPU cycles a tick instead of 32.
+//TCB1 only wakes the loop, time is the RTC.  The two clocks drift and a busy pass can see more
+//than one RTC tick, so anything run per tick steps by RTC_tickUpdate(), not by one a pass.
+//The RTC can not interrupt every tick itself: the PIT is 4 ticks at the shortest and CMP needs
+//a couple of RTC clocks to synchronise each new value
+#define TIMER_TICK_CCMP		((F_CPU / 2 / 1024) - 1)	// CLK_PER / 2 counts per tick, 3905
+#define TIMER_TICK_SLOW_CLK	32768UL						// OSCULP32K, Charger_enter() turns the prescaler off
+#define TIMER_TICK_SLOW_HZ	32
+#define TIMER_TICK_SLOW_CCMP	((TIMER_TICK_SLOW_CLK / 2 / TIMER_TICK_SLOW_HZ) - 1)	// 511
+
 void RTC_init(void);
 
 uint16_t RTC_getTick(void);
 
-void RTC_delayMS(uint16_t delay);
+uint16_t RTC_elapsedMS(uint16_t since);
+
+uint16_t RTC_tickUpdate(uint16_t *LastTick);
+
+void RTC_pitInit(uint8_t Period);
+
+void Timer_tickInit(void);
+
+void Timer_tickSlow(uint8_t Slow);
+
+void RTC_pitInterrupt(uint8_t Enable);
+
+uint8_t RTC_pitUpdate(uint8_t *LastCount);
+
+extern volatile uint8_t RTC_PitCount;
 
 #endif /* TIMER_H */
\ No newline at end of file
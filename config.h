@@ -11,7 +11,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-// Configuration Mode
+// Configuration Mode, the profile used while USERROW0 is blank (Profile.h)
 // 0 = MiniBell (default) - Use bell sound when button is released
 // 1 = Mini - Use short honk extension (3ms) when button is released
 #define CONFIG_MODE 0
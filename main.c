@@ -14,18 +14,32 @@
 #include <stdbool.h>
 #include <util/delay.h>
 #include <avr/wdt.h>
+#include <avr/sleep.h>
 
 #include "Switch.h"
-//#include "ADC.h"
+#include "ADC.h"
 #include "Timer.h"
 #include "Led.h"
 #include "Charger.h"
 #include "Horn.h"
 #include "LowVoltKill.h"
-#include "Config.h"
+#include "Gpio.h"
+#include "Event.h"
+#include "Energy.h"
+#include "Resume.h"
+#include "Profile.h"
+#include "Sag.h"
 
 #define BOOTEND_FUSE               (0x00)
 
+//CLK_PER is the OSC20M fuse frequency over the MCLKCTRLB prescaler main() sets, every timer
+//constant is worked out from F_CPU so the project has to agree with them
+#define MAIN_OSC_HZ		16000000UL	// FREQSEL_16MHZ_gc
+#define MAIN_PDIV		2			// CLKCTRL_PEN_bm, PDIV 0
+#if F_CPU != (MAIN_OSC_HZ / MAIN_PDIV)
+#error "F_CPU does not match the OSCCFG fuse and the MCLKCTRLB prescaler"
+#endif
+
 FUSES = {
 	.WDTCFG = PERIOD_2KCLK_gc | WINDOW_OFF_gc, // brownout detect voltage
 	.BODCFG = ACTIVE_ENABLED_gc | LVL_BODLEVEL7_gc,
@@ -40,7 +54,8 @@ FUSES = {
 	.BOOTEND = BOOTEND_FUSE
 };
 
-uint8_t LowSpeed;
+//local Functions
+static void Main_Update(void);
 
 
 int main(void)
@@ -49,64 +64,137 @@ int main(void)
  	_PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, CLKCTRL_PEN_bm | (0 << CLKCTRL_PDIV0_bp));
  	_PROTECTED_WRITE(CLKCTRL.MCLKCTRLA, CLKCTRL_CLKSEL_OSC20M_gc);
 	
+	ResumeCheckpoint Checkpoint;
+
+	Resume_Init();
 	RTC_init();
 	LED_init();
 	SwitchInit();
+	Profile_Init();
 	Charger_init();
 	// Bell_Init(); // This is now handled in LowVoltKill_init() as needed
 	LowVoltKill_init();
+	Sag_Init();
+	ADC_Init();
+	Energy_Init();
+
+	// brown-out or watchdog reset mid honk, pick up where it was
+	if(Resume_Check(&Checkpoint))
+	{
+		LowVoltKill_resume(&Checkpoint);
+	}
+#if HORN_CCL_BYPASS
+	Horn_CclInit();
+#endif
 	
-	LowSpeed = 0;
+	Timer_tickInit();
+	set_sleep_mode(SLEEP_MODE_IDLE);
 	
 	// Enable interrupts
 	sei();
 	
 	while (1)
 	{
+		Event Ev;
+
 		wdt_reset();
-		SwitchUpdate();
 
-		//If Charging: LED's are controlled by Charger, and horn is forced off
-		if(!(CHARGER_PWR_GOOD_PORT.IN & CHARGER_PWR_GOOD_BIT))
+		while(Event_Get(&Ev))
 		{
-			if(LowSpeed == 0)
+			// on the charger at 32kHz, the charging loop takes everything
+			if(ChargerLowSpeed)
 			{
-				_PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, CLKCTRL_PEN_bm | (0 << CLKCTRL_PDIV0_bp));
-				_PROTECTED_WRITE(CLKCTRL.MCLKCTRLA, CLKCTRL_CLKSEL_OSCULP32K_gc);
-				LowSpeed = 1;
+				Charger_event(&Ev);
+				continue;
 			}
 
-			Horn_Enable(HORN_OFF);
-
-			//LED_update();
-			if(!(CHARGER_STATUS_PORT.IN & CHARGER_STATUS_BIT))
+			switch (Ev.Type)
 			{
-				LED_Red(1);
-				LED_Green(0);
+				case EVENT_SAG:
+				{
+					Sag_Event(&Ev);
+					LowVoltKill_event(&Ev);
+					break;
+				}
 
-			}
-			else
-			{
-				LED_Red(0);
-				LED_Green(1);
+				case EVENT_ADC_WINDOW:
+				{
+					LowVoltKill_event(&Ev);
+					break;
+				}
 
+				// tick, switch and charger edges, everything polled runs off these
+				default:
+				{
+					Main_Update();
+					break;
+				}
 			}
 		}
 
-		else
-		//Not charging, honk horn unless fault found
+		if(ChargerLowSpeed)
 		{
-			if(LowSpeed == 1)
-			{
- 				_PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, CLKCTRL_PEN_bm | (0 << CLKCTRL_PDIV0_bp));
- 				_PROTECTED_WRITE(CLKCTRL.MCLKCTRLA, CLKCTRL_CLKSEL_OSC20M_gc);
-				LED_Green(0);
+			Charger_sleep();
+		}
+
+		// sleep until the next event, IDLE keeps TCA0 and the ADCs running
+		cli();
+		if(!Event_Pending())
+		{
+			sleep_enable();
+			sei();
+			sleep_cpu();
+			sleep_disable();
+		}
+		sei();
+	}
+}
 
-				LowSpeed = 0;
-			}
 
-			//LED_update();
-			LowVoltKill_update();
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Main_Update()
+//* Object              : charging or honking, run on every tick / switch / charger event
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Main_Update(void)
+{
+	SwitchUpdate();
+
+	//If Charging: LED's are controlled by Charger, and horn is forced off.  Charger_event()
+	//runs everything from here until unplugged
+	if(!GPIO_READ(CHARGER_PWR_GOOD))
+	{
+		Charger_enter();
+	}
+
+	else
+	//Not charging, honk horn unless fault found
+	{
+		//LED_update();
+		Profile_Update();
+		LowVoltKill_update();
+		Sound_Update();
+		Horn_Update();
+
+		Resume_Save();
+
+		if(LowVoltKill_isDead())
+		{
+			Energy_Update(ENERGY_DEAD);
+		}
+		else if(Horn_IsHonking())
+		{
+			Energy_Update(ENERGY_HORN);
+		}
+		else if(Horn_IsDriving())
+		{
+			Energy_Update(ENERGY_BELL);
+		}
+		else
+		{
+			Energy_Update(ENERGY_IDLE);
 		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+/*****************************************************************************************
+**
+**  horn_tone.c
+**
+**  Host test of the horn tone synthesis
+**  runs Horn_SetTone() and the TCA0 overflow dither from a host build of Horn.c against a
+**  model of TCA0, and reports how close each tone the firmware plays comes to the one asked
+**  for, in Hz and percent
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+//Build, from the repo root.  Horn.c is included so its static tone functions and the
+//overflow ISR can be driven directly, the register stand ins are the lvk_sim ones
+//   gcc -O2 -DF_CPU=8000000UL -Itools/lvk_sim/host -I. -o horn_tone tools/horn_tone/horn_tone.c -lm
+//Run
+//   ./horn_tone
+//Output is CSV on stdout, one line per distinct tone in the sound tables plus HORN_DRIVE_FREQ
+//and MAX_FREQ.  Exit status is 1 if any tone is off by more than TONE_TOL_PCT.
+//With HORN_DUAL_TONE set in Horn.h each distinct pair of split mode tones gets two more lines
+//from Horn_SetDualTone(), one per half off its 8 bit period, and a _beat line for the
+//difference between them, which fails if both halves land on the same count.
+//
+//Model.  TCA0 takes PERBUF into PER at the end of every period and then raises OVF, so the
+//value the ISR writes sets the period after next.  The main loop reloads the duty through
+//Horn_LoadPWM() once a tick, as battery compensation does while a sound plays, so a load
+//that clobbers the dithered period shows up here as a tone error.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../../Horn.c"
+
+#define TONE_PERIODS		200000UL	// measured periods per tone, after the warm up
+#define TONE_WARMUP			16			// periods before measuring, the old PER drains out
+#define TONE_TICK_HZ		1024		// main loop tick, Horn_LoadPWM() each tick
+#define TONE_SEEN_MAX		32			// distinct tones per table
+#if HORN_PER_DITHER
+#define TONE_TOL_PCT		0.001		// dithered, 1/256 count on the shortest period is 0.001%
+#else
+#define TONE_TOL_PCT		0.3			// whole counts, half a count on MAX_FREQ's 400
+#endif
+#define TONE_SPLIT_TOL_PCT	0.05		// split mode, whole 8 bit counts, table tones picked on a count
+
+//Registers and the globals the firmware headers declare
+PORT_t PORTA, PORTB, PORTC;
+AC_t AC0;
+DAC_t DAC0;
+VREF_t VREF;
+TCA_t TCA0;
+CCL_t CCL;
+EVSYS_t EVSYS;
+PORTMUX_t PORTMUX;
+register16_t SP;
+volatile uint16_t DiagIsrSPMin;
+SnapshotSeq DiagIsrSeq;
+
+//Sound_Update() and Horn_Update() need these to link, the test never calls them
+uint16_t RTC_getTick(void)
+{
+	return 0;
+}
+
+uint16_t RTC_elapsedMS(uint16_t Start)
+{
+	(void)Start;
+	return 0;
+}
+
+uint16_t RTC_tickUpdate(uint16_t *LastTick)
+{
+	(void)LastTick;
+	return 0;
+}
+
+uint8_t ADC_BattSenseUpdate(uint8_t *LastCount, uint16_t *Battery)
+{
+	(void)LastCount;
+	(void)Battery;
+	return 0;
+}
+
+//*--------------------------------------------------------------------------------------
+//* Tone_Measure(), play one tone and return the mean frequency over TONE_PERIODS
+//*--------------------------------------------------------------------------------------
+
+//*--------------------------------------------------------------------------------------
+//* Tone_Shift(), prescaler shift of the TCA0 clock select the firmware loaded
+//*--------------------------------------------------------------------------------------
+
+static uint8_t Tone_Shift(void)
+{
+	uint8_t Shift = 0;
+
+	for (uint8_t i = 0; i < sizeof(HornClkSels); i++)
+	{
+		if (HornClkSels[i] == HornClkSel)
+		{
+			Shift = HornClkShifts[i];
+		}
+	}
+
+	return Shift;
+}
+
+static double Tone_Measure(uint16_t Freq, uint32_t *Counts)
+{
+	uint8_t Shift;
+	uint64_t Total = 0;
+	double Tick_S = 0.0;
+	double Time_S = 0.0;
+
+	Horn_SetTone(Freq, HORN_DUTY_FULL / 2);
+	Shift = Tone_Shift();
+
+	*Counts = HornDitherTop;
+
+	for (uint32_t n = 0; n < TONE_WARMUP + TONE_PERIODS; n++)
+	{
+#if HORN_BRIDGE
+		uint32_t Period = 2UL * TCA0.SINGLE.PER;
+#else
+		uint32_t Period = TCA0.SINGLE.PER + 1UL;
+#endif
+
+		if (n >= TONE_WARMUP)
+		{
+			Total += Period;
+		}
+
+		// end of the period, UPDATE then OVF
+		TCA0.SINGLE.PER = TCA0.SINGLE.PERBUF;
+
+		if (TCA0.SINGLE.INTCTRL & TCA_SINGLE_OVF_bm)
+		{
+			TCA0_OVF_vect();
+		}
+
+		// main loop ticks that fell inside this period
+		Time_S += (double)(Period << Shift) / HORN_CPU_CLOCK;
+		while (Tick_S <= Time_S)
+		{
+			Horn_LoadPWM();
+			Tick_S += 1.0 / TONE_TICK_HZ;
+		}
+	}
+
+	return (double)TONE_PERIODS * HORN_CPU_CLOCK / ((double)Total * (1UL << Shift));
+}
+
+//*--------------------------------------------------------------------------------------
+//* Tone_Check(), measure one tone, print its line and return 1 if it is out of tolerance
+//*--------------------------------------------------------------------------------------
+
+static uint8_t Tone_Check(uint16_t Freq, const char *Source)
+{
+	uint32_t Counts;
+	double Hz = Tone_Measure(Freq, &Counts);
+	double Pct = 100.0 * (Hz - Freq) / Freq;
+	uint8_t Fail = fabs(Pct) > TONE_TOL_PCT;
+
+	printf("%s,%u,%.4f,%+.4f,%+.5f,%lu,%u,%s\n", Source, Freq, Hz, Hz - Freq, Pct,
+		(unsigned long)Counts, HornDitherFrac, Fail ? "FAIL" : "ok");
+
+	return Fail;
+}
+
+#if HORN_DUAL_TONE
+//*--------------------------------------------------------------------------------------
+//* Tone_Split(), play one pair through Horn_SetDualTone(), print a line per half and one
+//* for the beat, and return the number out of tolerance.  Split mode has no dither, each
+//* half is exactly its period, so the tone is worked out from the registers
+//*--------------------------------------------------------------------------------------
+
+static uint8_t Tone_Split(uint16_t Freq0, uint16_t Freq1, const char *Name)
+{
+	uint8_t Fails = 0;
+	const uint16_t Freq[2] = { Freq0, Freq1 };
+	uint16_t Counts[2];
+	double Hz[2];
+
+	Horn_SetDualTone(Freq0, HORN_DUTY_FULL / 2, Freq1, HORN_DUTY_FULL / 2);
+
+	Counts[0] = TCA0.SPLIT.LPER + 1U;
+	Counts[1] = TCA0.SPLIT.HPER + 1U;
+
+	for (uint8_t i = 0; i < 2; i++)
+	{
+		Hz[i] = (double)HORN_CPU_CLOCK / ((double)Counts[i] * (1UL << Tone_Shift()));
+
+		double Pct = 100.0 * (Hz[i] - Freq[i]) / Freq[i];
+		uint8_t Fail = fabs(Pct) > TONE_SPLIT_TOL_PCT;
+
+		printf("%s_split,%u,%.4f,%+.4f,%+.5f,%u,0,%s\n", Name, Freq[i], Hz[i], Hz[i] - Freq[i], Pct,
+			Counts[i], Fail ? "FAIL" : "ok");
+		Fails += Fail;
+	}
+
+	// tones that round to the same count play one pitch, no beat
+	uint16_t Asked = (Freq0 > Freq1) ? Freq0 - Freq1 : Freq1 - Freq0;
+	double Beat = fabs(Hz[0] - Hz[1]);
+	uint8_t Fail = Asked && Counts[0] == Counts[1];
+
+	printf("%s_beat,%u,%.4f,%+.4f,%+.5f,%d,0,%s\n", Name, Asked, Beat, Beat - Asked,
+		Asked ? 100.0 * (Beat - Asked) / Asked : 0.0, (int)Counts[1] - (int)Counts[0], Fail ? "FAIL" : "ok");
+
+	return Fails + Fail;
+}
+#endif
+
+//*--------------------------------------------------------------------------------------
+//* Tone_Table(), check every distinct tone in one sound table.  HORN_DUAL_TONE steps with a
+//* second tone play in split mode and go to Tone_Split() instead, once per distinct pair
+//*--------------------------------------------------------------------------------------
+
+static uint8_t Tone_Table(const PWMSetting *Table, const char *Name)
+{
+	uint8_t Fails = 0;
+	uint16_t Seen[TONE_SEEN_MAX];
+	uint8_t SeenCount = 0;
+#if HORN_DUAL_TONE
+	uint16_t Split0 = 0;
+	uint16_t Split1 = 0;
+#endif
+
+	for (const PWMSetting *Step = Table; ; Step++)
+	{
+		uint8_t i = 0;
+
+#if HORN_DUAL_TONE
+		if (Step->frequency2)
+		{
+			if (Step->frequency != Split0 || Step->frequency2 != Split1)
+			{
+				Split0 = Step->frequency;
+				Split1 = Step->frequency2;
+				Fails += Tone_Split(Split0, Split1, Name);
+			}
+
+			if (Step->TimeNextStep == 0)
+			{
+				break;
+			}
+			continue;
+		}
+#endif
+
+		while (i < SeenCount && Seen[i] != Step->frequency)
+		{
+			i++;
+		}
+
+		if (i == SeenCount && SeenCount < TONE_SEEN_MAX)
+		{
+			Seen[SeenCount++] = Step->frequency;
+			Fails += Tone_Check(Step->frequency, Name);
+		}
+
+		if (Step->TimeNextStep == 0)
+		{
+			break;
+		}
+	}
+
+	return Fails;
+}
+
+int main(void)
+{
+	uint8_t Fails = 0;
+
+	TCA0.SINGLE.CTRLB = HORN_WGMODE | TCA_SINGLE_CMP0EN_bm;
+	HornClkSel = HORN_CLKSEL_NONE;
+	HornMode = BELL;
+
+	printf("source,asked_hz,played_hz,error_hz,error_pct,per,frac_256,result\n");
+
+	Fails += Tone_Table(pwm_bell, "pwm_bell");
+	Fails += Tone_Table(pwm_charging, "pwm_charging");
+	Fails += Tone_Table(pwm_lowvolt, "pwm_lowvolt");
+	Fails += Tone_Check(HORN_DRIVE_FREQ, "HORN_DRIVE_FREQ");
+	Fails += Tone_Check(MAX_FREQ, "MAX_FREQ");
+
+	fprintf(stderr, "%u tone(s) outside %.3f%%\n", Fails, TONE_TOL_PCT);
+
+	return Fails ? 1 : 0;
+}
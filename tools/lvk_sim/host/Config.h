@@ -0,0 +1,12 @@
+/*****************************************************************************************
+**
+**  Config.h
+**
+**  Host stand in, the firmware source includes "Config.h" and the file is config.h, which
+**  only resolves on a case insensitive file system
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#include "../../../config.h"
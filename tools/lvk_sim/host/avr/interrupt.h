@@ -0,0 +1,20 @@
+/*****************************************************************************************
+**
+**  avr/interrupt.h
+**
+**  Host stand in, an ISR becomes a plain function the simulator can call
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef LVK_SIM_AVR_INTERRUPT_H
+#define LVK_SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector, ...)	void vector(void); void vector(void)
+#define sei()				do { } while (0)
+#define cli()				do { } while (0)
+
+#endif /* LVK_SIM_AVR_INTERRUPT_H */
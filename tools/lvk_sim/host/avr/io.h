@@ -0,0 +1,141 @@
+/*****************************************************************************************
+**
+**  avr/io.h
+**
+**  Host stand in for the Tiny1616 registers LowVoltKill.c, Horn.c and their headers touch,
+**  plain memory the host tools read and write.  Bit values as the ATtiny1616 datasheet
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef LVK_SIM_AVR_IO_H
+#define LVK_SIM_AVR_IO_H
+
+#include <stdint.h>
+
+//the project passes F_CPU, CLK_PER: 16MHz OSC20M / 2
+#ifndef F_CPU
+#define F_CPU					8000000UL
+#endif
+
+typedef volatile uint8_t register8_t;
+typedef volatile uint16_t register16_t;
+
+typedef struct
+{
+	register8_t DIR, DIRSET, DIRCLR, DIRTGL, OUT, OUTSET, OUTCLR, OUTTGL, IN, INTFLAGS, PORTCTRL;
+	register8_t PIN0CTRL, PIN1CTRL, PIN2CTRL, PIN3CTRL, PIN4CTRL, PIN5CTRL, PIN6CTRL, PIN7CTRL;
+} PORT_t;
+
+typedef struct
+{
+	register8_t CTRLA, MUXCTRLA, INTCTRL, STATUS;
+} AC_t;
+
+typedef struct
+{
+	register8_t CTRLA, DATA;
+} DAC_t;
+
+typedef struct
+{
+	register8_t DIR, OUT, IN, INTFLAGS;
+} VPORT_t;
+
+typedef struct
+{
+	register8_t CTRLA, CTRLB, CTRLC, CTRLD, CTRLECLR, CTRLESET, INTCTRL, INTFLAGS;
+	register16_t CNT, PER, CMP0, CMP1, CMP2, PERBUF, CMP0BUF, CMP1BUF, CMP2BUF;
+} TCA_SINGLE_t;
+
+typedef struct
+{
+	register8_t CTRLA, CTRLB, CTRLC, CTRLD, CTRLECLR, CTRLESET, INTCTRL, INTFLAGS;
+	register8_t LCNT, HCNT, LPER, HPER, LCMP0, HCMP0, LCMP1, HCMP1, LCMP2, HCMP2;
+} TCA_SPLIT_t;
+
+typedef union
+{
+	TCA_SINGLE_t SINGLE;
+	TCA_SPLIT_t SPLIT;
+} TCA_t;
+
+typedef struct
+{
+	register8_t CTRLA, SEQCTRL0, INTCTRL0, INTFLAGS;
+	register8_t LUT0CTRLA, LUT0CTRLB, LUT0CTRLC, TRUTH0, LUT1CTRLA, LUT1CTRLB, LUT1CTRLC, TRUTH1;
+} CCL_t;
+
+typedef struct
+{
+	register8_t ASYNCCH0, ASYNCCH1, ASYNCCH2, ASYNCCH3, SYNCCH0, SYNCCH1;
+	register8_t ASYNCUSER0, ASYNCUSER1, ASYNCUSER2, ASYNCUSER3, ASYNCUSER4, ASYNCUSER12;
+} EVSYS_t;
+
+typedef struct
+{
+	register8_t CTRLA, CTRLB, CTRLC, CTRLD;
+} PORTMUX_t;
+
+typedef struct
+{
+	register8_t CTRLA, CTRLB, CTRLC, CTRLD;
+} VREF_t;
+
+extern PORT_t PORTA, PORTB, PORTC;
+extern AC_t AC0;
+extern DAC_t DAC0;
+extern VREF_t VREF;
+extern TCA_t TCA0;
+extern CCL_t CCL;
+extern EVSYS_t EVSYS;
+extern PORTMUX_t PORTMUX;
+extern register16_t SP;
+
+//Gpio.h works out VPORTn from the PORTn address.  The host tools only compile the pin
+//helpers, they never call them
+#define _SFR_MEM_ADDR(sfr)		((uintptr_t)&(sfr))
+
+#define PORT_ISC0_bp			0
+#define PORT_PULLUPEN_bm		0x08
+#define PORT_INVEN_bm			0x80
+
+#define VREF_DAC0REFSEL_1V1_gc	(0x01 << 0)
+#define VREF_ADC0REFSEL_1V1_gc	(0x01 << 4)
+
+#define AC_ENABLE_bm			0x01
+#define AC_HYSMODE_10mV_gc		(0x01 << 1)
+#define AC_INVERT_bp			7
+#define AC_MUXPOS_PIN0_gc		(0x00 << 3)
+#define AC_MUXNEG_DAC_gc		(0x03 << 0)
+#define AC_CMP_bm				0x01
+#define AC_STATE_bm				0x10
+
+#define DAC_ENABLE_bm			0x01
+
+#define RTC_PERIOD_CYC1024_gc	(0x0A << 3)
+
+#define TCA_SINGLE_ENABLE_bm				0x01
+#define TCA_SINGLE_CLKSEL_DIV1_gc			(0x00 << 1)
+#define TCA_SINGLE_CLKSEL_DIV2_gc			(0x01 << 1)
+#define TCA_SINGLE_CLKSEL_DIV4_gc			(0x02 << 1)
+#define TCA_SINGLE_CLKSEL_DIV8_gc			(0x03 << 1)
+#define TCA_SINGLE_CLKSEL_DIV16_gc			(0x04 << 1)
+#define TCA_SINGLE_CLKSEL_DIV64_gc			(0x05 << 1)
+#define TCA_SINGLE_CLKSEL_DIV256_gc			(0x06 << 1)
+#define TCA_SINGLE_CLKSEL_DIV1024_gc		(0x07 << 1)
+#define TCA_SINGLE_WGMODE_SINGLESLOPE_gc	(0x03 << 0)
+#define TCA_SINGLE_WGMODE_DSBOTTOM_gc		(0x07 << 0)
+#define TCA_SINGLE_CMP0EN_bm				0x10
+#define TCA_SINGLE_CMP2EN_bm				0x40
+#define TCA_SINGLE_CMD_RESET_gc				(0x03 << 2)
+#define TCA_SINGLE_OVF_bm					0x01
+#define TCA_SPLIT_ENABLE_bm					0x01
+#define TCA_SPLIT_SPLITM_bm					0x01
+#define TCA_SPLIT_LCMP0EN_bm				0x01
+#define TCA_SPLIT_HCMP0EN_bm				0x10
+
+#define PORTMUX_TCA03_bm					0x08
+
+#endif /* LVK_SIM_AVR_IO_H */
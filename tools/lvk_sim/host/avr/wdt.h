@@ -0,0 +1,16 @@
+/*****************************************************************************************
+**
+**  avr/wdt.h
+**
+**  Host stand in, no watchdog
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef LVK_SIM_AVR_WDT_H
+#define LVK_SIM_AVR_WDT_H
+
+#define wdt_reset()			do { } while (0)
+
+#endif /* LVK_SIM_AVR_WDT_H */
@@ -0,0 +1,39 @@
+/*****************************************************************************************
+**
+**  lvk_param.h
+**
+**  Forced include (-include) for the host build of LowVoltKill.c.  Turns the constants
+**  under test into variables the optimizer sets per candidate, and replaces Gpio.h whose
+**  VPORT address arithmetic only works on the part
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+#ifndef LVK_PARAM_H
+#define LVK_PARAM_H
+
+#include <stdint.h>
+
+extern uint8_t SimKillDac;
+extern uint8_t SimLowBattDac;
+extern uint16_t SimCusumThreshold;
+extern uint16_t SimWaitLowBattBeep;
+extern uint16_t SimBellDebounce;
+
+#define LOW_VOLT_KILL_DAC_CNT				SimKillDac
+#define LOW_VOLT_LOW_BATT_DAC_CNT			SimLowBattDac
+#define LOW_VOLT_CUSUM_THRESHOLD			SimCusumThreshold
+#define LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP	SimWaitLowBattBeep
+#define BELL_DEBOUNCE_T						SimBellDebounce
+
+#define GPIO_H
+#define GPIO_SET(pin)			((pin##_PORT).OUT |= (pin##_BIT))
+#define GPIO_CLR(pin)			((pin##_PORT).OUT &= ~(pin##_BIT))
+#define GPIO_TGL(pin)			((pin##_PORT).OUT ^= (pin##_BIT))
+#define GPIO_WRITE(pin, value)	((value) ? GPIO_SET(pin) : GPIO_CLR(pin))
+#define GPIO_READ(pin)			(((pin##_PORT).IN & (pin##_BIT)) ? 1 : 0)
+#define GPIO_OUTPUT(pin)		((pin##_PORT).DIR |= (pin##_BIT))
+#define GPIO_INPUT(pin)			((pin##_PORT).DIR &= ~(pin##_BIT))
+
+#endif /* LVK_PARAM_H */
@@ -0,0 +1,1342 @@
+/*****************************************************************************************
+**
+**  lvk_sim.c
+**
+**  Host Monte Carlo optimizer for the LowVoltKill.h constants
+**  runs a host build of LowVoltKill.c against synthetic discharge curves and rider press
+**  patterns, one worker process per core, scores every candidate constant set on honks per
+**  charge, premature cutoffs and brownout risk, and prints the Pareto-optimal sets
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+//Build, from the repo root.  LowVoltKill.c gets lvk_param.h forced in so the constants under
+//test are variables; this file is built without it and so sees the shipped values
+//   gcc -O2 -c -Itools/lvk_sim/host -include tools/lvk_sim/lvk_param.h -o lvk.o LowVoltKill.c
+//   gcc -O2 -Itools/lvk_sim/host -I. -o lvk_sim tools/lvk_sim/lvk_sim.c lvk.o -lm
+//Run
+//   ./lvk_sim [-c candidates] [-n scenarios] [-j workers] [-s seed] [-f start SoC %]
+//   ./lvk_sim -b [-s seed]
+//Output is CSV on stdout, the shipped set first then the Pareto front, progress on stderr.
+//
+//-b benchmarks the low battery detector on the shipped constants instead, against the
+//targets in LowVoltKill.h, and exits 1 if one is missed.  AC0 follows a synthetic trace in
+//place of the pack: while a sound loads it each sample is low with a fixed probability.
+//   false alarms     SIM_BENCH_HOURS of 4S honks at 5, 10, 15 and 20% of samples low
+//   detection delay  SIM_BENCH_TRIALS honks each at 50, 75 and 100% low, cleared detector
+//ADC1 gives no readings and no sags are posted, so only the AC0 half is measured.
+//
+//Workers are processes, not threads: LowVoltKill.c keeps its state in file scope globals, so
+//each worker needs its own copy of them.  Every candidate sees the same scenarios and the
+//same rider presses (common random numbers), only the pack noise stream follows the run.
+//
+//Model, per cell of the pack, with the divider fixed by the shipped levels:
+//LOW_VOLT_LOW_BATT_DAC_CNT 0x27 is a 3.30V loaded cell, so 0x24 is 3.05V.
+//   open circuit voltage from a Li-ion table, less I * R with R doubling from 15% charge to empty
+//   per tick gaussian noise on the cell voltage, a triangle of horn PWM ripple on top whose
+//   troughs become EVENT_SAG when they are as long as Sag.c would log
+//   ADC1 reads the same node as AC0, 16x the DAC0 counts
+//   the rail browns out below SIM_BROWNOUT_V loaded; the part resets and boots again
+//   sounds draw a fixed current for their length, the bell and low battery sequences are
+//   as long as pwm_bell / pwm_lowvolt in Horn.c
+//Each scenario starts at the start SoC, below which the constants matter, and runs to
+//LOW_VOLT_STATE_DEAD or an empty pack.  Honks per charge adds the tail that was simulated
+//to the part above the start, at the honks per coulomb the tail achieved.
+//Scores
+//   honks per charge   presses meant as a honk that did honk (a tap that honks is lost charge)
+//   premature cutoff   % of scenarios killed above SIM_RESERVE_SOC, or warned of a low pack
+//                      above SIM_WARN_SOC
+//   brownout risk      brownout resets per 1000 honks
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "LowVoltKill.h"
+#include "Profile.h"
+#include "Horn.h"
+#include "Switch.h"
+#include "Led.h"
+#include "ADC.h"
+#include "Timer.h"
+#include "Event.h"
+#include "Diag.h"
+#include "Sag.h"
+
+//Pack and rider model
+#define SIM_TICK_S			(1.0f / 1024.0f)
+#define SIM_COUNTS_PER_V	(39.0f / 3.30f)	// DAC0 counts per loaded cell volt, 0x27 = 3.30V
+#define SIM_BROWNOUT_V		2.90f			// loaded cell voltage the rail drops out at
+#define SIM_IDLE_A			0.003f
+#define SIM_BELL_MS			2266			// pwm_bell
+#define SIM_LOWBATT_MS		820				// pwm_lowvolt
+#define SIM_HORN_BUDGET_MS	24000			// cold horn faded out, Horn.h drive budget
+#define SIM_TAP_MIN_MS		30				// a press meant as the bell
+#define SIM_TAP_MAX_MS		150
+#define SIM_HONK_MIN_MS		60				// a press meant as a honk, lognormal between
+#define SIM_HONK_MAX_MS		8000
+#define SIM_HONK_SIGMA		0.7f
+#define SIM_SETTLE_MAX		20000			// ticks to let the state machine go quiet
+#define SIM_BOOT_MAX		200
+#define SIM_BROWNOUT_MAX	64				// resets before a scenario counts as run flat
+#define SIM_RESERVE_SOC		0.05f			// killed with more than this left is premature
+#define SIM_WARN_SOC		0.25f			// warned with more than this left is premature
+#define SIM_GAUSS_SIZE		4096
+
+//Detector benchmark, -b, and its targets on the shipped constants
+#define SIM_BENCH_HONK_MS			4000	// one press of the false alarm trace
+#define SIM_BENCH_HOURS				40.0f	// of honking per false alarm trace
+#define SIM_BENCH_TRIALS			1000	// per detection delay trace
+#define SIM_BENCH_HEALTHY_LOW		0.10f	// healthy packs are up to this share of samples low
+#define SIM_BENCH_ALARMS_PER_HOUR	0.1f	// of honking on a healthy pack, 95% upper bound
+#define SIM_BENCH_DELAY_MEAN_MS		60		// on a pack low half the time or more
+#define SIM_BENCH_DELAY_MAX_MS		150
+
+//Defaults
+#define SIM_CANDIDATES		256
+#define SIM_SCENARIOS		32
+#define SIM_START_SOC		35
+
+typedef struct
+{
+	uint8_t KillDac;
+	uint8_t LowBattDac;
+	uint16_t CusumThreshold;
+	uint16_t WaitLowBattBeep;
+	uint16_t BellDebounce;
+} SimParams;
+
+typedef struct
+{
+	float Capacity_C;
+	float R_Ohm;			// per cell
+	float HornA;
+	float BellA;
+	float Noise_V;			// per tick, per cell
+	float Ripple_V;			// horn PWM trough below the mean, per cell
+	float HonkShare;		// of presses meant as a honk
+	float HonkMedian_mS;
+	float GapMean_S;
+	uint64_t Seed;
+} SimScenario;
+
+typedef struct
+{
+	uint32_t Index;
+	float HonksPerCharge;
+	float PrematurePct;
+	float BrownoutsPer1000;
+	uint32_t Honks;
+} SimResult;
+
+typedef struct
+{
+	uint32_t Honks;
+	uint32_t Brownouts;
+	float Charge_C;
+	uint8_t Warned;
+	float WarnSoc;
+} SimTally;
+
+typedef struct
+{
+	uint16_t Tick;
+	float Soc;
+	float Charge_C;
+	uint64_t NoiseRng;
+	uint64_t RiderRng;
+	uint8_t Horn;
+	uint16_t HornOn_mS;
+	uint8_t HornStarted;
+	uint16_t Bell_mS;
+	uint16_t LowBatt_mS;
+	uint8_t Killed;
+	uint8_t Pressed;		// rider
+	uint8_t Switch;			// debounced, as Switch.c
+	uint8_t SwitchTimer;
+	uint8_t SwitchCleared;
+	uint8_t AdcCount;
+	uint16_t Adc;
+	uint8_t WindowBelow;
+	uint8_t Brownout;
+	float TraceLow;			// benchmark, share of loaded AC0 samples low
+} SimState;
+
+static const SimParams SimShipped =
+{
+	LOW_VOLT_KILL_DAC_CNT, LOW_VOLT_LOW_BATT_DAC_CNT, LOW_VOLT_CUSUM_THRESHOLD,
+	LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP, BELL_DEBOUNCE_T
+};
+static const SimParams SimMin = { 0x1E, 0x22, 80, 250, 40 };
+static const SimParams SimMax = { 0x2A, 0x2E, 1200, 4000, 400 };
+
+static const float SimOcvSoc[] = { 0.00f, 0.02f, 0.05f, 0.10f, 0.20f, 0.30f, 0.40f, 0.50f, 0.60f, 0.70f, 0.80f, 0.90f, 1.00f };
+static const float SimOcvV[]   = { 3.00f, 3.20f, 3.35f, 3.45f, 3.55f, 3.62f, 3.68f, 3.73f, 3.79f, 3.87f, 3.95f, 4.05f, 4.18f };
+#define SIM_OCV_POINTS	(sizeof(SimOcvSoc) / sizeof(SimOcvSoc[0]))
+
+//Registers and the globals the firmware headers declare
+PORT_t PORTA, PORTB, PORTC;
+AC_t AC0;
+DAC_t DAC0;
+VREF_t VREF;
+register16_t SP;
+volatile uint16_t DiagIsrSPMin;
+SnapshotSeq DiagIsrSeq;
+volatile uint8_t EventTicks;
+volatile uint8_t SagHighTick;
+volatile uint8_t SagOpen;
+volatile uint8_t RTC_PitCount;
+
+//Constants under test, lvk_param.h
+uint8_t SimKillDac;
+uint8_t SimLowBattDac;
+uint16_t SimCusumThreshold;
+uint16_t SimWaitLowBattBeep;
+uint16_t SimBellDebounce;
+
+//LowVoltKill.c internals the simulator watches
+extern uint8_t LowVoltState;
+extern uint8_t LowVoltDetected;
+extern uint8_t LowVoltAfeSampling;
+extern uint16_t LowVoltkillTimer_mS;
+
+//The profile LowVoltKill.c runs, Profile.c is not built so the bell profile the
+//shipped CONFIG_MODE runs is set here
+const Profile SimProfile = { LowVoltKill_checkBellMiniBell, LowVoltKill_releaseMiniBell, 0,
+							  { HORN_SOFT_START_MS, HORN_HOLD_MS, HORN_SUSTAIN_DUTY } };
+const Profile *ProfileActive = &SimProfile;
+
+static SimState Sim;
+static const SimScenario *Scn;
+static float SimGauss[SIM_GAUSS_SIZE];
+static float SimStartSoc = SIM_START_SOC / 100.0f;
+
+//local Functions
+static void Sim_Tick(void);
+
+
+//*--------------------------------------------------------------------------------------
+//* Random numbers, xorshift64*
+//*--------------------------------------------------------------------------------------
+
+static uint64_t Sim_Next(uint64_t *Rng)
+{
+	*Rng ^= *Rng >> 12;
+	*Rng ^= *Rng << 25;
+	*Rng ^= *Rng >> 27;
+	return *Rng * 2685821657736338717ULL;
+}
+
+static float Sim_Uniform(uint64_t *Rng, float Lo, float Hi)
+{
+	return Lo + (Hi - Lo) * (float)(Sim_Next(Rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+static uint64_t Sim_Seed(uint64_t Seed, uint64_t Index)
+{
+	uint64_t z = Seed + (Index + 1) * 0x9E3779B97F4A7C15ULL;
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	return z ? z : 1;
+}
+
+static void Sim_GaussInit(void)
+{
+	uint64_t Rng = Sim_Seed(0x6A09E667F3BCC909ULL, 0);
+
+	for(uint32_t i = 0; i < SIM_GAUSS_SIZE; i += 2)
+	{
+		float u1 = Sim_Uniform(&Rng, 1e-7f, 1.0f);
+		float u2 = Sim_Uniform(&Rng, 0.0f, 1.0f);
+		float r = sqrtf(-2.0f * logf(u1));
+
+		SimGauss[i] = r * cosf(6.2831853f * u2);
+		SimGauss[i + 1] = r * sinf(6.2831853f * u2);
+	}
+}
+
+static float Sim_Gauss(uint64_t *Rng)
+{
+	return SimGauss[Sim_Next(Rng) >> (64 - 12)];
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Firmware stand ins, the functions LowVoltKill.c calls in the other modules
+//*--------------------------------------------------------------------------------------
+
+uint16_t RTC_getTick(void)
+{
+	return Sim.Tick;
+}
+
+uint16_t RTC_elapsedMS(uint16_t since)
+{
+	return (uint16_t)(Sim.Tick - since);
+}
+
+uint16_t RTC_tickUpdate(uint16_t *LastTick)
+{
+	uint16_t Ticks = Sim.Tick - *LastTick;
+
+	*LastTick = Sim.Tick;
+	return Ticks;
+}
+
+void RTC_pitInit(uint8_t Period)
+{
+	(void)Period;
+}
+
+void RTC_pitInterrupt(uint8_t Enable)
+{
+	(void)Enable;
+}
+
+uint8_t RTC_pitUpdate(uint8_t *LastCount)
+{
+	if(*LastCount == RTC_PitCount)
+	{
+		return 0;
+	}
+
+	*LastCount = RTC_PitCount;
+	return 1;
+}
+
+void Event_Post(uint8_t Type, uint8_t Data)
+{
+	(void)Type;
+	(void)Data;
+}
+
+uint8_t ADC_BattSenseUpdate(uint8_t *LastCount, uint16_t *Battery)
+{
+	if(*LastCount == Sim.AdcCount)
+	{
+		return 0;
+	}
+
+	*LastCount = Sim.AdcCount;
+	*Battery = Sim.Adc;
+	return 1;
+}
+
+uint8_t SwitchHornGetStatus(void)
+{
+	return Sim.Switch && !Sim.SwitchCleared;
+}
+
+void SwitchClearHornStatus(void)
+{
+	Sim.SwitchCleared = 1;
+}
+
+void SwitchResume(uint8_t Pressed)
+{
+	Sim.Switch = Pressed;
+}
+
+void LED_Red(uint8_t Enable)
+{
+	(void)Enable;
+}
+
+void LED_Green(uint8_t Enable)
+{
+	(void)Enable;
+}
+
+void Sound_Start(SpeakerState Sound)
+{
+	if(Sim.Killed)
+	{
+		return;
+	}
+
+	if(Sound == HORN_ON)
+	{
+		if(!Sim.Horn)
+		{
+			Sim.HornOn_mS = 0;
+		}
+
+		Sim.Horn = 1;
+		Sim.HornStarted = 1;
+	}
+	else if(Sound == BELL)
+	{
+		Sim.Bell_mS = SIM_BELL_MS;
+	}
+	else if(Sound == BELL_LOWVOLT)
+	{
+		Sim.LowBatt_mS = SIM_LOWBATT_MS;
+	}
+}
+
+void Sound_Stop(SpeakerState Sound)
+{
+	if(Sound == HORN_ON)
+	{
+		Sim.Horn = 0;
+	}
+	else if(Sound == BELL)
+	{
+		Sim.Bell_mS = 0;
+	}
+	else if(Sound == BELL_LOWVOLT)
+	{
+		Sim.LowBatt_mS = 0;
+	}
+}
+
+uint8_t Sound_IsPlaying(SpeakerState Sound)
+{
+	if(Sound == HORN_ON)
+	{
+		return Sim.Horn;
+	}
+	else if(Sound == BELL)
+	{
+		return Sim.Bell_mS != 0;
+	}
+	else if(Sound == BELL_LOWVOLT)
+	{
+		return Sim.LowBatt_mS != 0;
+	}
+
+	return 0;
+}
+
+SpeakerState Sound_Current(void)
+{
+	if(Sim.Horn)
+	{
+		return HORN_ON;
+	}
+	else if(Sim.Bell_mS)
+	{
+		return BELL;
+	}
+	else if(Sim.LowBatt_mS)
+	{
+		return BELL_LOWVOLT;
+	}
+
+	return HORN_OFF;
+}
+
+void Sound_Kill(uint8_t Enable)
+{
+	Sim.Killed = Enable;
+
+	if(Enable)
+	{
+		Sim.Horn = 0;
+		Sim.Bell_mS = 0;
+		Sim.LowBatt_mS = 0;
+	}
+}
+
+uint8_t Horn_IsDriving(void)
+{
+	return Sim.Horn || Sim.Bell_mS || Sim.LowBatt_mS;
+}
+
+uint8_t Horn_BudgetSpent(void)
+{
+	return Sim.Horn && Sim.HornOn_mS >= SIM_HORN_BUDGET_MS;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Ocv()
+//* Object              : open circuit cell voltage at a state of charge
+//* Input Parameters    : float Soc = 0 to 1
+//* Output Parameters   : float = volts
+//*--------------------------------------------------------------------------------------
+
+static float Sim_Ocv(float Soc)
+{
+	if(Soc <= SimOcvSoc[0])
+	{
+		return SimOcvV[0];
+	}
+
+	for(uint32_t i = 1; i < SIM_OCV_POINTS; i++)
+	{
+		if(Soc <= SimOcvSoc[i])
+		{
+			float f = (Soc - SimOcvSoc[i - 1]) / (SimOcvSoc[i] - SimOcvSoc[i - 1]);
+
+			return SimOcvV[i - 1] + f * (SimOcvV[i] - SimOcvV[i - 1]);
+		}
+	}
+
+	return SimOcvV[SIM_OCV_POINTS - 1];
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Pack()
+//* Object              : draw the load off the pack, set AC0 and ADC1 from the loaded voltage
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Pack(void)
+{
+	float Amps = SIM_IDLE_A;
+
+	if(Sim.Horn)
+	{
+		Amps = Scn->HornA;
+	}
+	else if(Sim.Bell_mS || Sim.LowBatt_mS)
+	{
+		Amps = Scn->BellA;
+	}
+
+	Sim.Soc -= Amps * SIM_TICK_S / Scn->Capacity_C;
+	Sim.Charge_C += Amps * SIM_TICK_S;
+
+	float R = Scn->R_Ohm;
+
+	if(Sim.Soc < 0.15f)
+	{
+		R *= 2.0f - Sim.Soc / 0.15f;
+	}
+
+	float Volts = Sim_Ocv(Sim.Soc) - Amps * R + Scn->Noise_V * Sim_Gauss(&Sim.NoiseRng);
+	float Counts = Volts * SIM_COUNTS_PER_V;
+
+	if(Volts < SIM_BROWNOUT_V)
+	{
+		Sim.Brownout = 1;
+	}
+
+	// AC0 against DAC0.  The horn ripple troughs land between ticks and only TCB0 sees them,
+	// each carrier period the triangle spends Below of its time under DAC0
+	if(AC0.CTRLA & AC_ENABLE_bm)
+	{
+		if(Counts > DAC0.DATA)
+		{
+			AC0.STATUS |= AC_STATE_bm;
+		}
+		else
+		{
+			AC0.STATUS &= ~AC_STATE_bm;
+		}
+
+		float Swing = 2.0f * Scn->Ripple_V * SIM_COUNTS_PER_V;
+		float Below = (DAC0.DATA - (Counts - Swing / 2.0f)) / Swing;
+
+		if(Sim.Horn && SagOpen && Counts > DAC0.DATA &&
+		   Below * 1000000.0f / HORN_DRIVE_FREQ >= SAG_MIN_US)
+		{
+			Event Ev = { .Type = EVENT_SAG };
+
+			LowVoltKill_event(&Ev);
+		}
+	}
+	else
+	{
+		AC0.STATUS &= ~AC_STATE_bm;
+	}
+
+	// ADC1 pack reading and its window
+	float Reading = Counts * 16.0f;
+
+	Sim.Adc = (Reading < 0.0f) ? 0 : (Reading > 4095.0f) ? 4095 : (uint16_t)Reading;
+	Sim.AdcCount++;
+
+	if(!Sim.WindowBelow && Sim.Adc < ADC_WINDOW_LOW_CNT)
+	{
+		Event Ev = { .Type = EVENT_ADC_WINDOW, .Data = 1 };
+
+		Sim.WindowBelow = 1;
+		LowVoltKill_event(&Ev);
+	}
+	else if(Sim.WindowBelow && Sim.Adc > ADC_WINDOW_LOW_CNT + ADC_WINDOW_HYST)
+	{
+		Event Ev = { .Type = EVENT_ADC_WINDOW, .Data = 0 };
+
+		Sim.WindowBelow = 0;
+		LowVoltKill_event(&Ev);
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Trace()
+//* Object              : benchmark AC0 in place of the pack: while a sound loads the pack
+//*                       each sample is low with the trace probability, high otherwise.
+//*                       ADC1 gives no new readings and no sags are posted, so only the
+//*                       AC0 half of the detector is scored
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Trace(void)
+{
+	if((AC0.CTRLA & AC_ENABLE_bm) &&
+	   !(Horn_IsDriving() && Sim_Uniform(&Sim.NoiseRng, 0.0f, 1.0f) < Sim.TraceLow))
+	{
+		AC0.STATUS |= AC_STATE_bm;
+	}
+	else
+	{
+		AC0.STATUS &= ~AC_STATE_bm;
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Tick()
+//* Object              : one RTC tick: the pack or the benchmark trace sets AC0 and ADC1,
+//*                       debounce the rider, run the sounds and the module
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Tick(void)
+{
+	if(Scn)
+	{
+		Sim_Pack();
+	}
+	else
+	{
+		Sim_Trace();
+	}
+
+	// horn switch debounce, a clear holds until the rider lets go
+	if(Sim.Pressed != Sim.Switch)
+	{
+		if(++Sim.SwitchTimer >= TIME_SWITCH_PRESS_DET)
+		{
+			Sim.Switch = Sim.Pressed;
+			Sim.SwitchTimer = 0;
+
+			if(!Sim.Switch)
+			{
+				Sim.SwitchCleared = 0;
+			}
+		}
+	}
+	else
+	{
+		Sim.SwitchTimer = 0;
+	}
+
+	// sounds, the bell waits behind the horn and the low battery warning behind both
+	if(Sim.Horn)
+	{
+		if(Sim.HornOn_mS < 0xFFFF)
+		{
+			Sim.HornOn_mS++;
+		}
+	}
+	else if(Sim.Bell_mS)
+	{
+		Sim.Bell_mS--;
+	}
+	else if(Sim.LowBatt_mS)
+	{
+		Sim.LowBatt_mS--;
+	}
+
+	Sim.Tick++;
+
+	if((Sim.Tick & 1023) == 0)
+	{
+		RTC_PitCount++;
+	}
+
+	LowVoltKill_update();
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Quiet()
+//* Object              : nothing left for the module to do until the next press or PIT
+//* Input Parameters    : none
+//* Output Parameters   : uint8_t = 1 when the clock can be skipped ahead
+//*--------------------------------------------------------------------------------------
+
+static uint8_t Sim_Quiet(void)
+{
+	if(LowVoltState == LOW_VOLT_STATE_DEAD)
+	{
+		return 1;
+	}
+
+	if(Horn_IsDriving() || LowVoltAfeSampling || Sim.Switch != Sim.Pressed)
+	{
+		return 0;
+	}
+
+	if(LowVoltState == LOW_VOLT_STATE_CHECK_HORN0)
+	{
+		return !(LowVoltDetected && LowVoltkillTimer_mS == 0);
+	}
+
+	return LowVoltState == LOW_VOLT_STATE_END_BEEP;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Run()
+//* Object              : tick until quiet, a brownout, or the limit
+//* Input Parameters    : uint32_t Limit = most ticks
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Run(uint32_t Limit)
+{
+	for(uint32_t i = 0; i < Limit && !Sim.Brownout; i++)
+	{
+		Sim_Tick();
+
+		if(Sim_Quiet())
+		{
+			break;
+		}
+	}
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Boot()
+//* Object              : power up or brownout reset, cold (no resume checkpoint)
+//* Input Parameters    : none
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Boot(void)
+{
+	memset((void *)&AC0, 0, sizeof(AC0));
+	memset((void *)&DAC0, 0, sizeof(DAC0));
+	Sim.Horn = 0;
+	Sim.Bell_mS = 0;
+	Sim.LowBatt_mS = 0;
+	Sim.Killed = 0;
+	Sim.Brownout = 0;
+	Sim.Switch = Sim.Pressed;
+	Sim.SwitchCleared = 0;
+
+	LowVoltKill_init();
+
+	for(uint32_t i = 0; i < SIM_BOOT_MAX && !Sim.Brownout; i++)
+	{
+		Sim_Tick();
+
+		if(LowVoltState != LOW_VOLT_STATE_INIT && LowVoltState != LOW_VOLT_STATE_KILL)
+		{
+			break;
+		}
+	}
+
+	Sim_Run(SIM_SETTLE_MAX);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Press()
+//* Object              : the rider holds the horn switch, then lets the module settle
+//* Input Parameters    : uint32_t Hold_mS = press length
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Press(uint32_t Hold_mS)
+{
+	Sim.HornStarted = 0;
+	Sim.Pressed = 1;
+
+	for(uint32_t i = 0; i < Hold_mS && !Sim.Brownout; i++)
+	{
+		Sim_Tick();
+	}
+
+	Sim.Pressed = 0;
+	Sim_Run(SIM_SETTLE_MAX);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Gap()
+//* Object              : skip the clock over an idle gap, the module steps its own timers
+//*                       over it, and take the last parked PIT sample of the gap
+//* Input Parameters    : float Gap_S
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Gap(float Gap_S)
+{
+	uint32_t Ticks = (uint32_t)(Gap_S * 1024.0f);
+
+	Sim.Soc -= SIM_IDLE_A * Gap_S / Scn->Capacity_C;
+	Sim.Charge_C += SIM_IDLE_A * Gap_S;
+	// in steps the 16 bit tick difference can hold, the module sees all of the gap
+	for(uint32_t Left = Ticks; Left; )
+	{
+		uint32_t Step = (Left > 0x8000) ? 0x8000 : Left;
+
+		Sim.Tick += (uint16_t)Step;
+		Left -= Step;
+		LowVoltKill_update();
+	}
+
+	if(Ticks >= 1024)
+	{
+		RTC_PitCount++;
+	}
+
+	Sim_Run(SIM_SETTLE_MAX);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_ScenarioMake()
+//* Object              : draw one pack and rider
+//* Input Parameters    : SimScenario *s, uint64_t Seed, uint32_t Index
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_ScenarioMake(SimScenario *s, uint64_t Seed, uint32_t Index)
+{
+	uint64_t Rng = Sim_Seed(Seed, Index);
+
+	s->Capacity_C = Sim_Uniform(&Rng, 1500.0f, 3000.0f) * 3.6f;
+	s->R_Ohm = Sim_Uniform(&Rng, 0.04f, 0.20f);
+	s->HornA = Sim_Uniform(&Rng, 1.2f, 2.0f);
+	s->BellA = s->HornA * 0.4f;
+	s->Noise_V = Sim_Uniform(&Rng, 0.005f, 0.03f);
+	s->Ripple_V = Sim_Uniform(&Rng, 0.02f, 0.08f);
+	s->HonkShare = Sim_Uniform(&Rng, 0.4f, 0.9f);
+	s->HonkMedian_mS = Sim_Uniform(&Rng, 300.0f, 1200.0f);
+	s->GapMean_S = Sim_Uniform(&Rng, 5.0f, 60.0f);
+	s->Seed = Sim_Next(&Rng);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Scenario()
+//* Object              : run one pack from the start SoC until it is killed or empty
+//* Input Parameters    : const SimScenario *s, SimTally *t
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Scenario(const SimScenario *s, SimTally *t)
+{
+	Scn = s;
+	memset(&Sim, 0, sizeof(Sim));
+	memset(t, 0, sizeof(*t));
+	Sim.Soc = SimStartSoc;
+	Sim.NoiseRng = Sim_Seed(s->Seed, 1);
+	Sim.RiderRng = Sim_Seed(s->Seed, 2);
+
+	Sim_Boot();
+
+	while(LowVoltState != LOW_VOLT_STATE_DEAD && Sim.Soc > 0.0f && t->Brownouts < SIM_BROWNOUT_MAX)
+	{
+		uint8_t Honk = Sim_Uniform(&Sim.RiderRng, 0.0f, 1.0f) < s->HonkShare;
+		float Hold;
+
+		if(Honk)
+		{
+			Hold = s->HonkMedian_mS * expf(SIM_HONK_SIGMA * Sim_Gauss(&Sim.RiderRng));
+			Hold = fminf(fmaxf(Hold, SIM_HONK_MIN_MS), SIM_HONK_MAX_MS);
+		}
+		else
+		{
+			Hold = Sim_Uniform(&Sim.RiderRng, SIM_TAP_MIN_MS, SIM_TAP_MAX_MS);
+		}
+
+		float Gap = -s->GapMean_S * logf(Sim_Uniform(&Sim.RiderRng, 1e-6f, 1.0f));
+
+		Sim_Press((uint32_t)Hold);
+
+		if(Honk && Sim.HornStarted)
+		{
+			t->Honks++;
+		}
+
+		if(LowVoltDetected && !t->Warned)
+		{
+			t->Warned = 1;
+			t->WarnSoc = Sim.Soc;
+		}
+
+		if(Sim.Brownout)
+		{
+			t->Brownouts++;
+			Sim.Pressed = 0;
+			Sim_Boot();
+			continue;
+		}
+
+		Sim_Gap(Gap);
+	}
+
+	t->Charge_C = Sim.Charge_C;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_BenchStart()
+//* Object              : cold boot on a healthy trace, no scenario so Sim_Tick runs the trace
+//* Input Parameters    : uint64_t Seed, uint32_t Index
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_BenchStart(uint64_t Seed, uint32_t Index)
+{
+	Scn = 0;
+	memset(&Sim, 0, sizeof(Sim));
+	Sim.NoiseRng = Sim_Seed(Seed ^ 0xBE4C4BE4CULL, Index);
+	Sim_Boot();
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_BenchFalse()
+//* Object              : false alarms on a healthy trace: honk SIM_BENCH_HONK_MS at a time
+//*                       until the loaded time is run, an alarm reboots and carries on
+//* Input Parameters    : float Low = share of loaded samples low, float Hours = of honking,
+//*                       uint64_t Seed
+//* Output Parameters   : uint32_t = alarms
+//*--------------------------------------------------------------------------------------
+
+static uint32_t Sim_BenchFalse(float Low, float Hours, uint64_t Seed)
+{
+	uint64_t Loaded = 0;
+	uint64_t Limit = (uint64_t)(Hours * 3600.0f * 1024.0f);
+	uint32_t Alarms = 0;
+
+	Sim_BenchStart(Seed, (uint32_t)(Low * 1000.0f));
+	Sim.TraceLow = Low;
+
+	while(Loaded < Limit)
+	{
+		Sim.Pressed = 1;
+
+		for(uint32_t i = 0; i < SIM_BENCH_HONK_MS && !LowVoltDetected; i++)
+		{
+			Sim_Tick();
+			Loaded += Sim.Horn;
+		}
+
+		Sim.Pressed = 0;
+
+		if(LowVoltDetected)
+		{
+			Alarms++;
+			Sim_Boot();
+		}
+		else
+		{
+			Sim_Run(SIM_SETTLE_MAX);
+		}
+	}
+
+	return Alarms;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_BenchDelay()
+//* Object              : detection delay on a failing trace, from the first loaded sample
+//*                       of a honk on a cleared detector to low battery
+//* Input Parameters    : float Low = share of loaded samples low, uint64_t Seed, uint32_t Index
+//* Output Parameters   : uint32_t = ticks, 0 when the honk ended first
+//*--------------------------------------------------------------------------------------
+
+static uint32_t Sim_BenchDelay(float Low, uint64_t Seed, uint32_t Index)
+{
+	uint32_t Loaded = 0;
+
+	Sim_BenchStart(Seed, Index);
+	Sim.TraceLow = Low;
+	Sim.Pressed = 1;
+
+	for(uint32_t i = 0; i < SIM_BENCH_HONK_MS && !LowVoltDetected; i++)
+	{
+		Sim_Tick();
+		Loaded += Sim.Horn;
+	}
+
+	return LowVoltDetected ? Loaded : 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Bench()
+//* Object              : run the detector benchmark on the shipped constants, print it, and
+//*                       check it against the targets
+//* Input Parameters    : float Hours = of honking per false alarm trace, uint32_t Trials =
+//*                       per delay trace, uint64_t Seed
+//* Output Parameters   : int = 0 when the targets are met
+//*--------------------------------------------------------------------------------------
+
+static int Sim_Bench(float Hours, uint32_t Trials, uint64_t Seed)
+{
+	static const float Healthy[] = { 0.05f, 0.10f, 0.15f, 0.20f };
+	static const float Failing[] = { 0.50f, 0.75f, 1.00f };
+	int Failed = 0;
+
+	SimKillDac = SimShipped.KillDac;
+	SimLowBattDac = SimShipped.LowBattDac;
+	SimCusumThreshold = SimShipped.CusumThreshold;
+	SimWaitLowBattBeep = SimShipped.WaitLowBattBeep;
+	SimBellDebounce = SimShipped.BellDebounce;
+
+	printf("false_alarm,low_pct,honk_hours,alarms,per_hour,result\n");
+
+	for(uint32_t i = 0; i < sizeof(Healthy) / sizeof(Healthy[0]); i++)
+	{
+		uint32_t Alarms = Sim_BenchFalse(Healthy[i], Hours, Seed);
+		float PerHour = Alarms / Hours;
+		// (alarms + 3) / hours is the 95% upper bound on the rate, rule of three for none
+		uint8_t Pass = Healthy[i] > SIM_BENCH_HEALTHY_LOW || Alarms + 3.0f <= SIM_BENCH_ALARMS_PER_HOUR * Hours;
+
+		Failed |= !Pass;
+		printf("false_alarm,%.0f,%.1f,%u,%.4f,%s\n", Healthy[i] * 100.0f, Hours, Alarms, PerHour,
+			   (Healthy[i] > SIM_BENCH_HEALTHY_LOW) ? "info" : Pass ? "ok" : "FAIL");
+	}
+
+	printf("delay,low_pct,trials,mean_ms,max_ms,missed,result\n");
+
+	for(uint32_t i = 0; i < sizeof(Failing) / sizeof(Failing[0]); i++)
+	{
+		uint32_t Max = 0;
+		uint32_t Missed = 0;
+		double Sum = 0;
+
+		for(uint32_t t = 0; t < Trials; t++)
+		{
+			uint32_t Ticks = Sim_BenchDelay(Failing[i], Seed, t);
+
+			Missed += (Ticks == 0);
+			Sum += Ticks;
+			Max = (Ticks > Max) ? Ticks : Max;
+		}
+
+		float MaxMs = Max * 1000.0f / 1024.0f;
+		float MeanMs = (Trials > Missed) ? Sum * 1000.0 / 1024.0 / (Trials - Missed) : 0.0f;
+		uint8_t Pass = !Missed && MeanMs <= SIM_BENCH_DELAY_MEAN_MS && MaxMs <= SIM_BENCH_DELAY_MAX_MS;
+
+		Failed |= !Pass;
+		printf("delay,%.0f,%u,%.1f,%.1f,%u,%s\n", Failing[i] * 100.0f, Trials, MeanMs, MaxMs, Missed,
+			   Pass ? "ok" : "FAIL");
+	}
+
+	return Failed;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Candidate()
+//* Object              : score one constant set over every scenario
+//* Input Parameters    : const SimParams *p, const SimScenario *Scenarios, uint32_t Count,
+//*                       SimResult *r
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_Candidate(const SimParams *p, const SimScenario *Scenarios, uint32_t Count, SimResult *r)
+{
+	uint32_t Premature = 0;
+	uint32_t Brownouts = 0;
+	double HonksPerCharge = 0;
+
+	SimKillDac = p->KillDac;
+	SimLowBattDac = p->LowBattDac;
+	SimCusumThreshold = p->CusumThreshold;
+	SimWaitLowBattBeep = p->WaitLowBattBeep;
+	SimBellDebounce = p->BellDebounce;
+
+	r->Honks = 0;
+
+	for(uint32_t i = 0; i < Count; i++)
+	{
+		SimTally t;
+
+		Sim_Scenario(&Scenarios[i], &t);
+
+		// the charge above the start SoC, at the honks per coulomb of the tail
+		float Above_C = Scenarios[i].Capacity_C * (1.0f - SimStartSoc);
+
+		HonksPerCharge += t.Honks + (t.Charge_C > 0 ? t.Honks * Above_C / t.Charge_C : 0);
+
+		if((LowVoltState == LOW_VOLT_STATE_DEAD && Sim.Soc > SIM_RESERVE_SOC) ||
+		   (t.Warned && t.WarnSoc > SIM_WARN_SOC))
+		{
+			Premature++;
+		}
+
+		Brownouts += t.Brownouts;
+		r->Honks += t.Honks;
+	}
+
+	r->HonksPerCharge = HonksPerCharge / Count;
+	r->PrematurePct = 100.0f * Premature / Count;
+	r->BrownoutsPer1000 = r->Honks ? 1000.0f * Brownouts / r->Honks : 1000.0f * Brownouts;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_CandidateMake()
+//* Object              : draw a constant set, candidate 0 is the shipped one
+//* Input Parameters    : SimParams *p, uint64_t Seed, uint32_t Index
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Sim_CandidateMake(SimParams *p, uint64_t Seed, uint32_t Index)
+{
+	uint64_t Rng = Sim_Seed(Seed ^ 0xC0DEC0DEULL, Index);
+
+	if(Index == 0)
+	{
+		*p = SimShipped;
+		return;
+	}
+
+	do
+	{
+		p->KillDac = (uint8_t)Sim_Uniform(&Rng, SimMin.KillDac, SimMax.KillDac + 1);
+		p->LowBattDac = (uint8_t)Sim_Uniform(&Rng, SimMin.LowBattDac, SimMax.LowBattDac + 1);
+	} while(p->LowBattDac <= p->KillDac);
+
+	p->CusumThreshold = (uint16_t)Sim_Uniform(&Rng, SimMin.CusumThreshold, SimMax.CusumThreshold + 1);
+	p->WaitLowBattBeep = (uint16_t)Sim_Uniform(&Rng, SimMin.WaitLowBattBeep, SimMax.WaitLowBattBeep + 1);
+	p->BellDebounce = (uint16_t)Sim_Uniform(&Rng, SimMin.BellDebounce, SimMax.BellDebounce + 1);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Sim_Dominates()
+//* Object              : a at least as good as b on every score and better on one
+//* Input Parameters    : const SimResult *a, const SimResult *b
+//* Output Parameters   : uint8_t
+//*--------------------------------------------------------------------------------------
+
+static uint8_t Sim_Dominates(const SimResult *a, const SimResult *b)
+{
+	if(a->HonksPerCharge < b->HonksPerCharge || a->PrematurePct > b->PrematurePct ||
+	   a->BrownoutsPer1000 > b->BrownoutsPer1000)
+	{
+		return 0;
+	}
+
+	return a->HonksPerCharge > b->HonksPerCharge || a->PrematurePct < b->PrematurePct ||
+		   a->BrownoutsPer1000 < b->BrownoutsPer1000;
+}
+
+static int Sim_ByHonks(const void *a, const void *b)
+{
+	const SimResult *ra = a;
+	const SimResult *rb = b;
+
+	return (ra->HonksPerCharge < rb->HonksPerCharge) - (ra->HonksPerCharge > rb->HonksPerCharge);
+}
+
+static void Sim_Print(const SimResult *r, uint64_t Seed, const char *Tag)
+{
+	SimParams p;
+
+	Sim_CandidateMake(&p, Seed, r->Index);
+	printf("%s,0x%02X,0x%02X,%u,%u,%u,%.1f,%.2f,%.3f\n", Tag, p.KillDac, p.LowBattDac,
+		   p.CusumThreshold, p.WaitLowBattBeep, p.BellDebounce,
+		   r->HonksPerCharge, r->PrematurePct, r->BrownoutsPer1000);
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : main()
+//* Object              : fork one worker per core over the candidates, gather, print the front
+//*--------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+	uint32_t Candidates = SIM_CANDIDATES;
+	uint32_t Scenarios = SIM_SCENARIOS;
+	long Workers = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t Seed = 1;
+	uint8_t Bench = 0;
+	int Opt;
+
+	while((Opt = getopt(argc, argv, "c:n:j:s:f:b")) != -1)
+	{
+		switch(Opt)
+		{
+			case 'c': Candidates = strtoul(optarg, 0, 0); break;
+			case 'n': Scenarios = strtoul(optarg, 0, 0); break;
+			case 'j': Workers = strtol(optarg, 0, 0); break;
+			case 's': Seed = strtoull(optarg, 0, 0); break;
+			case 'f': SimStartSoc = strtof(optarg, 0) / 100.0f; break;
+			case 'b': Bench = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-c candidates] [-n scenarios] [-j workers] [-s seed] [-f start SoC %%] [-b]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	if(Candidates == 0 || Scenarios == 0 || SimStartSoc <= 0.0f || SimStartSoc > 1.0f)
+	{
+		fprintf(stderr, "%s: bad option\n", argv[0]);
+		return 2;
+	}
+
+	if(Bench)
+	{
+		return Sim_Bench(SIM_BENCH_HOURS, SIM_BENCH_TRIALS, Seed);
+	}
+
+	if(Workers < 1)
+	{
+		Workers = 1;
+	}
+
+	if((uint32_t)Workers > Candidates)
+	{
+		Workers = Candidates;
+	}
+
+	SimScenario *Scenario = calloc(Scenarios, sizeof(SimScenario));
+	SimResult *Result = calloc(Candidates, sizeof(SimResult));
+	int (*Pipe)[2] = calloc(Workers, sizeof(*Pipe));
+	struct timespec Start, End;
+
+	if(!Scenario || !Result || !Pipe)
+	{
+		perror("calloc");
+		return 1;
+	}
+
+	Sim_GaussInit();
+
+	for(uint32_t i = 0; i < Scenarios; i++)
+	{
+		Sim_ScenarioMake(&Scenario[i], Seed, i);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &Start);
+	fprintf(stderr, "%u candidates x %u scenarios from %.0f%% charge on %ld workers\n",
+			Candidates, Scenarios, SimStartSoc * 100.0f, Workers);
+
+	// candidates are dealt round robin, each worker writes its results down its own pipe
+	for(long w = 0; w < Workers; w++)
+	{
+		if(pipe(Pipe[w]) != 0)
+		{
+			perror("pipe");
+			return 1;
+		}
+
+		pid_t Pid = fork();
+
+		if(Pid < 0)
+		{
+			perror("fork");
+			return 1;
+		}
+
+		if(Pid == 0)
+		{
+			close(Pipe[w][0]);
+
+			for(uint32_t c = w; c < Candidates; c += Workers)
+			{
+				SimParams p;
+				SimResult r;
+
+				Sim_CandidateMake(&p, Seed, c);
+				Sim_Candidate(&p, Scenario, Scenarios, &r);
+				r.Index = c;
+
+				if(write(Pipe[w][1], &r, sizeof(r)) != sizeof(r))
+				{
+					_exit(1);
+				}
+			}
+
+			_exit(0);
+		}
+
+		close(Pipe[w][1]);
+	}
+
+	uint32_t Done = 0;
+	uint64_t Honks = 0;
+
+	for(long w = 0; w < Workers; w++)
+	{
+		SimResult r;
+
+		while(read(Pipe[w][0], &r, sizeof(r)) == sizeof(r))
+		{
+			Result[r.Index] = r;
+			Honks += r.Honks;
+			Done++;
+		}
+
+		close(Pipe[w][0]);
+	}
+
+	while(wait(0) > 0)
+	{
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &End);
+	fprintf(stderr, "%u candidates, %llu simulated honks in %.1fS\n", Done, (unsigned long long)Honks,
+			(End.tv_sec - Start.tv_sec) + (End.tv_nsec - Start.tv_nsec) * 1e-9);
+
+	if(Done != Candidates)
+	{
+		fprintf(stderr, "%s: a worker failed\n", argv[0]);
+		return 1;
+	}
+
+	// Pareto front: no other candidate does at least as well on all three scores
+	SimResult *Front = calloc(Candidates, sizeof(SimResult));
+	uint32_t FrontCount = 0;
+
+	for(uint32_t i = 0; i < Candidates; i++)
+	{
+		uint8_t Dominated = 0;
+
+		for(uint32_t j = 0; j < Candidates && !Dominated; j++)
+		{
+			Dominated = (j != i) && Sim_Dominates(&Result[j], &Result[i]);
+		}
+
+		if(!Dominated)
+		{
+			Front[FrontCount++] = Result[i];
+		}
+	}
+
+	qsort(Front, FrontCount, sizeof(SimResult), Sim_ByHonks);
+
+	printf("set,LOW_VOLT_KILL_DAC_CNT,LOW_VOLT_LOW_BATT_DAC_CNT,LOW_VOLT_CUSUM_THRESHOLD,"
+		   "LOW_VOLT_TIME_WAIT_LOW_BATT_BEEP,BELL_DEBOUNCE_T,honks_per_charge,premature_pct,"
+		   "brownouts_per_1000_honks\n");
+	Sim_Print(&Result[0], Seed, "shipped");
+
+	for(uint32_t i = 0; i < FrontCount; i++)
+	{
+		Sim_Print(&Front[i], Seed, "pareto");
+	}
+
+	free(Front);
+	free(Pipe);
+	free(Result);
+	free(Scenario);
+	return 0;
+}
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Static RAM per module from the avr-gcc map file.
+
+    python3 tools/ram_report.py Debug/LoudBike.map
+
+Sums the .data and .bss input sections of every object file listed in the
+map and prints them largest first, with the stack left over out of the
+ATtiny1616's 2 KB.
+"""
+
+import re
+import sys
+from collections import defaultdict
+
+RAM_SIZE = 2048
+
+# " .bss.HornDuty  0x00803f10  0x2 Horn.o"  (the object may wrap onto the next line)
+SECTION = re.compile(r'^ (\.(?:data|bss)(?:\.\S+)?)\s*$|^ (\.(?:data|bss)(?:\.\S+)?)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)')
+WRAPPED = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)')
+
+
+def module(path):
+    name = re.split(r'[\\/]', path)[-1]
+    return re.sub(r'\(.*\)$', '', name)
+
+
+def parse(lines):
+    sizes = defaultdict(lambda: [0, 0])
+    pending = None
+    in_memory_map = False
+    for line in lines:
+        if line.startswith('Linker script and memory map'):
+            in_memory_map = True
+            continue
+        if not in_memory_map:
+            continue
+        if pending:
+            m = WRAPPED.match(line)
+            if m:
+                add(sizes, pending, int(m.group(2), 16), m.group(3))
+            pending = None
+            continue
+        m = SECTION.match(line)
+        if not m:
+            continue
+        if m.group(1):
+            pending = m.group(1)
+        else:
+            add(sizes, m.group(2), int(m.group(4), 16), m.group(5))
+    return sizes
+
+
+def add(sizes, section, size, obj):
+    if size:
+        sizes[module(obj)][0 if section.startswith('.data') else 1] += size
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1]) as f:
+        sizes = parse(f)
+    total = 0
+    print('%-24s %6s %6s %6s' % ('module', 'data', 'bss', 'total'))
+    for name, (data, bss) in sorted(sizes.items(), key=lambda kv: -sum(kv[1])):
+        print('%-24s %6d %6d %6d' % (name, data, bss, data + bss))
+        total += data + bss
+    print('%-24s %20d' % ('static RAM', total))
+    print('%-24s %20d' % ('left for stack', RAM_SIZE - total))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,179 @@
+/*****************************************************************************************
+**
+**  snapshot_test.c
+**
+**  Host stress test of the Snapshot.h retry read
+**  a writer thread interrupts a reader as fast as it can, the interrupt writes a multi byte
+**  value and its complement and publishes, the reader checks every copy for a torn value
+**
+**  2023 CPU Ready Inc
+**
+******************************************************************************************/
+
+//Build, from the repo root, with the lvk_sim register stand ins for <avr/io.h>
+//   gcc -O2 -Itools/lvk_sim/host -I. -o snapshot_test tools/snapshot_test/snapshot_test.c -lpthread
+//Run
+//   ./snapshot_test [reads]
+//Output is one line per pass on stdout, a pass on one core takes several seconds.  Exit status is 1 if SNAPSHOT_READ() returned a torn
+//value, or if the plain copy never tore (the interrupts missed the copies, so the test
+//proved nothing).
+//
+//Model.  Snapshot.h relies on the ISR running to the end before the main loop carries on,
+//not on memory ordering between cores, so the writer is not a second core writing the value
+//directly: it sends SIGUSR1 to the reader thread and the handler is the ISR.  The handler
+//preempts the reader at any instruction and runs to completion on its stack, as an AVR
+//interrupt does.  The reader first copies with no retry, which has to tear for the test to
+//mean anything, then with SNAPSHOT_READ(), which must never tear.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+#include "Snapshot.h"
+
+#define SNAP_READS			20000000UL	// least copies per pass
+#define SNAP_INTERRUPTS		1000		// least interrupts per pass, one core takes one a slice
+
+typedef struct
+{
+	uint32_t Value;
+	uint32_t Check;			// ~Value, a copy where they disagree is torn
+} SnapValue;
+
+static volatile SnapValue SnapSource;
+static SnapshotSeq SnapSeq;
+static volatile uint32_t SnapIsrCount;
+static volatile uint8_t SnapDone;
+static pthread_t SnapReader;
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Snap_Isr()
+//* Object              : the interrupt, write the next value a byte at a time and publish
+//* Input Parameters    : int Sig
+//* Output Parameters   : none
+//*--------------------------------------------------------------------------------------
+
+static void Snap_Isr(int Sig)
+{
+	uint32_t Value = SnapSource.Value + 1;
+	uint32_t Check = ~Value;
+
+	(void)Sig;
+
+	for(uint8_t i = 0; i < sizeof(Value); i++)
+	{
+		((volatile uint8_t *)&SnapSource.Value)[i] = ((uint8_t *)&Value)[i];
+		((volatile uint8_t *)&SnapSource.Check)[i] = ((uint8_t *)&Check)[i];
+	}
+
+	SNAPSHOT_PUBLISH(SnapSeq);
+	SnapIsrCount++;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Snap_Writer()
+//* Object              : writer thread, interrupt the reader until it is done
+//* Input Parameters    : void *Arg
+//* Output Parameters   : void *
+//*--------------------------------------------------------------------------------------
+
+static void *Snap_Writer(void *Arg)
+{
+	(void)Arg;
+
+	while(!SnapDone)
+	{
+		pthread_kill(SnapReader, SIGUSR1);
+	}
+
+	return 0;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : Snap_Pass()
+//* Object              : copy the value while the writer runs, at least Reads times and until
+//*                       SNAP_INTERRUPTS interrupts have landed, count torn copies
+//* Input Parameters    : uint8_t Retry = 1 for SNAPSHOT_READ(), 0 for a plain copy,
+//*                       uint32_t Reads, const char *Name
+//* Output Parameters   : uint32_t = torn copies
+//*--------------------------------------------------------------------------------------
+
+static uint32_t Snap_Pass(uint8_t Retry, uint32_t Reads, const char *Name)
+{
+	pthread_t Writer;
+	uint32_t Torn = 0;
+	uint32_t Count;
+	uint32_t Isrs = SnapIsrCount;
+
+	SnapDone = 0;
+
+	if(pthread_create(&Writer, 0, Snap_Writer, 0) != 0)
+	{
+		perror("pthread_create");
+		exit(1);
+	}
+
+	for(Count = 0; Count < Reads || SnapIsrCount - Isrs < SNAP_INTERRUPTS; Count++)
+	{
+		SnapValue Copy;
+
+		if(Retry)
+		{
+			SNAPSHOT_READ(SnapSeq, Copy, SnapSource);
+		}
+		else
+		{
+			for(uint8_t i = 0; i < sizeof(Copy); i++)
+			{
+				((uint8_t *)&Copy)[i] = ((const volatile uint8_t *)&SnapSource)[i];
+			}
+		}
+
+		Torn += (Copy.Check != ~Copy.Value);
+	}
+
+	SnapDone = 1;
+	pthread_join(Writer, 0);
+
+	printf("%s: %lu reads, %lu interrupts, %lu torn\n", Name, (unsigned long)Count,
+		   (unsigned long)(SnapIsrCount - Isrs), (unsigned long)Torn);
+
+	return Torn;
+}
+
+
+//*--------------------------------------------------------------------------------------
+//* Function Name       : main()
+//* Object              : the plain copy pass, then the SNAPSHOT_READ() pass
+//*--------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+	uint32_t Reads = (argc > 1) ? strtoul(argv[1], 0, 0) : SNAP_READS;
+	struct sigaction Action = { .sa_handler = Snap_Isr };
+
+	SnapSource.Check = ~SnapSource.Value;
+	SnapReader = pthread_self();
+	sigemptyset(&Action.sa_mask);
+
+	if(Reads == 0 || sigaction(SIGUSR1, &Action, 0) != 0)
+	{
+		fprintf(stderr, "usage: %s [reads]\n", argv[0]);
+		return 2;
+	}
+
+	uint32_t Plain = Snap_Pass(0, Reads, "plain copy");
+	uint32_t Snapshot = Snap_Pass(1, Reads, "SNAPSHOT_READ");
+
+	if(Plain == 0)
+	{
+		fprintf(stderr, "the plain copy never tore, the test did not interrupt a copy\n");
+		return 1;
+	}
+
+	return Snapshot ? 1 : 0;
+}